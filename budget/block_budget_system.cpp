@@ -0,0 +1,142 @@
+#include "block_budget_system.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const Date FIRST_DATE{2000, 1, 1};
+const Date LAST_DATE{2100, 1, 1};
+
+}  // namespace
+
+BlockBudgetSystem::BlockBudgetSystem()
+    : income_(Date::ComputeDaysDiff(LAST_DATE, FIRST_DATE) + 1),
+      spent_(income_.size()) {
+  block_size_ = static_cast<size_t>(std::sqrt(income_.size()));
+  blocks_.resize((income_.size() + block_size_ - 1) / block_size_);
+}
+
+BlockBudgetSystem::DayRange BlockBudgetSystem::MakeDayRange(
+    const Date& from, const Date& to) const {
+  return {static_cast<size_t>(Date::ComputeDaysDiff(from, FIRST_DATE)),
+          static_cast<size_t>(Date::ComputeDaysDiff(to, FIRST_DATE)) + 1};
+}
+
+BlockBudgetSystem::DayRange BlockBudgetSystem::GetBlockDays(size_t block) const {
+  return {block * block_size_,
+          std::min((block + 1) * block_size_, income_.size())};
+}
+
+template <typename DaysUpdater, typename BlockUpdater>
+void BlockBudgetSystem::Update(DayRange days, DaysUpdater update_days,
+                               BlockUpdater update_block) {
+  for (size_t day = days.begin; day < days.end;) {
+    const size_t block = day / block_size_;
+    const DayRange block_days = GetBlockDays(block);
+    if (day == block_days.begin && block_days.end <= days.end) {
+      update_block(blocks_[block], block_days.end - block_days.begin);
+    } else {
+      PushBlock(block);
+      update_days(day, std::min(block_days.end, days.end));
+      RecomputeBlock(block);
+    }
+    day = block_days.end;
+  }
+}
+
+void BlockBudgetSystem::PushBlock(size_t block) {
+  Block& b = blocks_[block];
+  const DayRange days = GetBlockDays(block);
+  for (size_t day = days.begin; day < days.end; ++day) {
+    income_[day] = income_[day] * b.income_factor + b.income_delta;
+    spent_[day] += b.spent_delta;
+  }
+  b.income_factor = 1;
+  b.income_delta = 0;
+  b.spent_delta = 0;
+}
+
+void BlockBudgetSystem::RecomputeBlock(size_t block) {
+  Block& b = blocks_[block];
+  const DayRange days = GetBlockDays(block);
+  b.income = 0;
+  b.spent = 0;
+  for (size_t day = days.begin; day < days.end; ++day) {
+    b.income += income_[day];
+    b.spent += spent_[day];
+  }
+}
+
+PureIncome BlockBudgetSystem::ComputeIncome(const Date& from,
+                                            const Date& to) const {
+  const DayRange days = MakeDayRange(from, to);
+  PureIncome res{0};
+  for (size_t day = days.begin; day < days.end;) {
+    const size_t block = day / block_size_;
+    const Block& b = blocks_[block];
+    const DayRange block_days = GetBlockDays(block);
+    if (day == block_days.begin && block_days.end <= days.end) {
+      res += b.income - b.spent;
+    } else {
+      const size_t end = std::min(block_days.end, days.end);
+      for (; day < end; ++day) {
+        res += income_[day] * b.income_factor + b.income_delta;
+        res -= spent_[day] + b.spent_delta;
+      }
+    }
+    day = block_days.end;
+  }
+  return res;
+}
+
+void BlockBudgetSystem::Earn(const Date& from, const Date& to,
+                             IncomeValue value) {
+  const DayRange days = MakeDayRange(from, to);
+  const PureIncome daily = PureIncome(value) / (days.end - days.begin);
+  Update(
+      days,
+      [&](size_t begin, size_t end) {
+        for (size_t day = begin; day < end; ++day) {
+          income_[day] += daily;
+        }
+      },
+      [daily](Block& block, size_t length) {
+        block.income_delta += daily;
+        block.income += daily * length;
+      });
+}
+
+void BlockBudgetSystem::Spend(const Date& from, const Date& to,
+                              IncomeValue value) {
+  const DayRange days = MakeDayRange(from, to);
+  const PureIncome daily = PureIncome(value) / (days.end - days.begin);
+  Update(
+      days,
+      [&](size_t begin, size_t end) {
+        for (size_t day = begin; day < end; ++day) {
+          spent_[day] += daily;
+        }
+      },
+      [daily](Block& block, size_t length) {
+        block.spent_delta += daily;
+        block.spent += daily * length;
+      });
+}
+
+void BlockBudgetSystem::PayTax(const Date& from, const Date& to,
+                               size_t percent) {
+  const PureIncome factor = BudgetSystem::ComputeIncomeAfterTax(1, percent);
+  Update(
+      MakeDayRange(from, to),
+      [&](size_t begin, size_t end) {
+        for (size_t day = begin; day < end; ++day) {
+          income_[day] *= factor;
+        }
+      },
+      [factor](Block& block, size_t) {
+        block.income_factor *= factor;
+        block.income_delta *= factor;
+        block.income *= factor;
+      });
+}
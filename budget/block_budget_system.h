@@ -0,0 +1,63 @@
+#ifndef BLOCK_BUDGET_H
+#define BLOCK_BUDGET_H
+
+#include <cstddef>
+#include <vector>
+
+#include "budget_system.h"
+#include "date.h"
+
+#ifdef BUDGET_TEST
+#include "budget_test.h"
+#endif
+
+// The same budget as BudgetSystem over an array of days instead of a map of
+// interval bounds. Days are split into blocks of about sqrt(day count); a
+// block keeps its sums and the operations applied to the whole block, so
+// any request touches two partial blocks day by day and skips over the rest.
+class BlockBudgetSystem {
+ public:
+  BlockBudgetSystem();
+
+  PureIncome ComputeIncome(const Date& from, const Date& to) const;
+  void Earn(const Date& from, const Date& to, IncomeValue value);
+  void Spend(const Date& from, const Date& to, IncomeValue value);
+  void PayTax(const Date& from, const Date& to, size_t percent = 13);
+
+#ifdef BUDGET_TEST
+  friend class TestBlockBudgetSystem;
+#endif
+ private:
+  // Operations postponed for every day of a block: income is multiplied by
+  // income_factor, then income_delta is added
+  struct Block {
+    PureIncome income = 0;
+    PureIncome spent = 0;
+    PureIncome income_factor = 1;
+    PureIncome income_delta = 0;
+    PureIncome spent_delta = 0;
+  };
+
+  struct DayRange {
+    size_t begin;
+    size_t end;
+  };
+
+  size_t block_size_;
+  std::vector<PureIncome> income_;
+  std::vector<PureIncome> spent_;
+  std::vector<Block> blocks_;
+
+  DayRange MakeDayRange(const Date& from, const Date& to) const;
+  DayRange GetBlockDays(size_t block) const;
+
+  // Calls update_days for the days of partial blocks and update_block for
+  // the whole blocks of the range
+  template <typename DaysUpdater, typename BlockUpdater>
+  void Update(DayRange days, DaysUpdater update_days, BlockUpdater update_block);
+
+  void PushBlock(size_t block);
+  void RecomputeBlock(size_t block);
+};
+
+#endif  // BLOCK_BUDGET_H
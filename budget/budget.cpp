@@ -38,6 +38,7 @@ int main() {
 #ifdef BUDGET_TEST
   TestDate::TestAll();
   TestBudgetSystem::TestAll();
+  TestBlockBudgetSystem::TestAll();
 #endif
 
   cout.precision(25);
@@ -3,11 +3,15 @@
 #include <algorithm>
 #include <iterator>
 #include <numeric>
+#include <random>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "block_budget_system.h"
 #include "budget_system.h"
 #include "date.h"
+#include "profile.h"
 #include "test_runner.h"
 
 using namespace std;
@@ -106,6 +110,22 @@ void TestDate::TestComputeDaysDiff() {
   ASSERT_EQUAL(Date::ComputeDaysDiff({2001, 1, 1}, {2000, 1, 1}), 366);
 }
 
+void TestDate::TestDayNumber() {
+  ASSERT_EQUAL(Date(2000, 1, 1).AsDayNumber(), 10957);
+
+  Date date{2000, 1, 1};
+  for (int day_number = date.AsDayNumber(); date < Date{2100, 1, 1}; ++day_number) {
+    ASSERT_EQUAL(date.AsDayNumber(), day_number);
+    ASSERT(Date::FromDayNumber(day_number) == date);
+    date = Date::Next(date);
+  }
+  ASSERT(date == Date(2100, 1, 1));
+
+  ASSERT(Date::Next({2000, 2, 28}) == Date(2000, 2, 29));
+  ASSERT(Date::Next({2001, 2, 28}) == Date(2001, 3, 1));
+  ASSERT(Date::Next({2099, 12, 31}) == Date(2100, 1, 1));
+}
+
 void TestDate::TestAll() {
   TestRunner tr;
   RUN_TEST(tr, TestConstructor);
@@ -113,6 +133,7 @@ void TestDate::TestAll() {
   RUN_TEST(tr, TestAsTimestamp);
   RUN_TEST(tr, TestFromString);
   RUN_TEST(tr, TestComputeDaysDiff);
+  RUN_TEST(tr, TestDayNumber);
 }
 
 void TestBudgetSystem::TestInsertNewIncome() {
@@ -364,3 +385,137 @@ void TestBudgetSystem::TestAll() {
   RUN_TEST(tr, TestPayTax);
   RUN_TEST(tr, TestComputeIncome);
 }
+
+void TestBlockBudgetSystem::TestComputeIncome() {
+  {
+    BlockBudgetSystem bs;
+
+    bs.Earn({2000, 1, 1}, {2000, 1, 1}, 100);
+    bs.Earn({2000, 1, 1}, {2000, 1, 2}, 100);
+    bs.PayTax({2000, 1, 1}, {2000, 1, 1});
+
+    ASSERT_EQUAL(bs.ComputeIncome({2000, 1, 1}, {2000, 1, 1}), PureIncome{130.5});
+    ASSERT_EQUAL(bs.ComputeIncome({2000, 1, 2}, {2000, 1, 2}), PureIncome{50});
+  }
+
+  {
+    // Whole blocks and both ends of the supported range
+    BlockBudgetSystem bs;
+
+    bs.Earn({2000, 1, 1}, {2100, 1, 1}, 36526);
+    bs.Spend({2000, 1, 2}, {2000, 1, 11}, 5);
+    bs.PayTax({2000, 1, 1}, {2099, 12, 31}, 50);
+
+    ASSERT_EQUAL(bs.ComputeIncome({2000, 1, 1}, {2000, 1, 1}), PureIncome{0.5});
+    ASSERT_EQUAL(bs.ComputeIncome({2100, 1, 1}, {2100, 1, 1}), PureIncome{1});
+    ASSERT_EQUAL(bs.ComputeIncome({2000, 1, 1}, {2100, 1, 1}), PureIncome{18263.5 - 5});
+  }
+
+  ASSERT_THROWS(([] { BlockBudgetSystem{}.PayTax({2000, 1, 1}, {2000, 1, 1}, 101); }));
+}
+
+namespace {
+
+enum class Operation {
+  COMPUTE_INCOME,
+  EARN,
+  SPEND,
+  PAY_TAX,
+};
+
+struct RandomRequest {
+  Operation operation;
+  Date from;
+  Date to;
+  size_t value;
+};
+
+vector<RandomRequest> MakeRandomRequests(size_t count, unsigned int seed) {
+  const int first_day = Date{2000, 1, 1}.AsDayNumber();
+  mt19937 generator{seed};
+  // BudgetSystem reads past its last bound for requests up to 2099-12-31
+  uniform_int_distribution<int> day{0, Date::ComputeDaysDiff({2099, 12, 30}, {2000, 1, 1})};
+  uniform_int_distribution<int> length{0, 400};
+  uniform_int_distribution<int> kind{0, 9};
+  uniform_int_distribution<size_t> value{1, 1'000'000};
+
+  vector<RandomRequest> requests;
+  for (size_t i = 0; i < count; ++i) {
+    int from = first_day + day(generator);
+    int to = kind(generator) < 7 ? min(from + length(generator), first_day + day.max()) : first_day + day(generator);
+    if (to < from) {
+      swap(from, to);
+    }
+    const int k = kind(generator);
+    const Operation operation = k < 4 ? Operation::COMPUTE_INCOME
+                              : k < 7 ? Operation::EARN
+                              : k < 9 ? Operation::SPEND
+                                      : Operation::PAY_TAX;
+    requests.push_back({operation, Date::FromDayNumber(from), Date::FromDayNumber(to),
+                        operation == Operation::PAY_TAX ? value(generator) % 100 : value(generator)});
+  }
+  return requests;
+}
+
+template <typename Budget>
+vector<PureIncome> ProcessRandomRequests(Budget& budget, const vector<RandomRequest>& requests) {
+  vector<PureIncome> incomes;
+  for (const auto& request : requests) {
+    switch (request.operation) {
+      case Operation::COMPUTE_INCOME:
+        incomes.push_back(budget.ComputeIncome(request.from, request.to));
+        break;
+      case Operation::EARN:
+        budget.Earn(request.from, request.to, request.value);
+        break;
+      case Operation::SPEND:
+        budget.Spend(request.from, request.to, request.value);
+        break;
+      case Operation::PAY_TAX:
+        budget.PayTax(request.from, request.to, request.value);
+        break;
+    }
+  }
+  return incomes;
+}
+
+}  // namespace
+
+void TestBlockBudgetSystem::TestMatchesBudgetSystem() {
+  const auto requests = MakeRandomRequests(3000, 1);
+  BudgetSystem map_budget;
+  BlockBudgetSystem block_budget;
+  const auto expected = ProcessRandomRequests(map_budget, requests);
+  const auto actual = ProcessRandomRequests(block_budget, requests);
+
+  ASSERT_EQUAL(actual.size(), expected.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    Assert(abs(actual[i] - expected[i]) <= 1e-6 * max(1.0, abs(expected[i])),
+           "income " + to_string(i) + ": " + to_string(actual[i]) + " != " + to_string(expected[i]));
+  }
+}
+
+void TestBlockBudgetSystem::BenchmarkEngines() {
+  const auto requests = MakeRandomRequests(20'000, 2);
+  PureIncome checksum = 0;
+  {
+    LOG_DURATION("BudgetSystem, 20000 requests");
+    BudgetSystem budget;
+    const auto incomes = ProcessRandomRequests(budget, requests);
+    checksum += accumulate(begin(incomes), end(incomes), PureIncome{0});
+  }
+  {
+    LOG_DURATION("BlockBudgetSystem, 20000 requests");
+    BlockBudgetSystem budget;
+    const auto incomes = ProcessRandomRequests(budget, requests);
+    checksum -= accumulate(begin(incomes), end(incomes), PureIncome{0});
+  }
+  cerr << "Budget engines checksum difference: " << checksum << endl;
+}
+
+void TestBlockBudgetSystem::TestAll() {
+  TestRunner tr;
+  RUN_TEST(tr, TestComputeIncome);
+  RUN_TEST(tr, TestMatchesBudgetSystem);
+  BenchmarkEngines();
+}
@@ -10,6 +10,7 @@ class TestDate {
   static void TestAsTimestamp();
   static void TestFromString();
   static void TestComputeDaysDiff();
+  static void TestDayNumber();
 };
 
 class TestBudgetSystem {
@@ -22,4 +23,13 @@ class TestBudgetSystem {
   static void TestPayTax();
 };
 
+class TestBlockBudgetSystem {
+ public:
+  static void TestAll();
+
+  static void TestComputeIncome();
+  static void TestMatchesBudgetSystem();
+  static void BenchmarkEngines();
+};
+
 #endif  // BUDGET_TEST_H
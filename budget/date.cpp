@@ -1,21 +1,23 @@
 #include "date.h"
 
 #include <sstream>
+#include <string_view>
 
-using namespace std;
+#include "civil_date.h"
 
-static const int SECONDS_IN_DAY = 60 * 60 * 24;
+using namespace std;
 
 int Date::ComputeDaysDiff(const Date& date_to, const Date& date_from) {
-  const time_t timestamp_to = date_to.AsTimestamp();
-  const time_t timestamp_from = date_from.AsTimestamp();
-  return (timestamp_to - timestamp_from) / SECONDS_IN_DAY;
+  return date_to.AsDayNumber() - date_from.AsDayNumber();
 }
 
 Date Date::Next(const Date& date) {
-  const time_t next_day_ts = date.AsTimestamp() + SECONDS_IN_DAY;
-  const tm* next_day = localtime(&next_day_ts);
-  return {1900 + next_day->tm_year, 1 + next_day->tm_mon, next_day->tm_mday};
+  return FromDayNumber(date.AsDayNumber() + 1);
+}
+
+Date Date::FromDayNumber(int day_number) {
+  const CivilDate date = CivilFromDays(day_number);
+  return {date.year, date.month, date.day};
 }
 
 Date::Date(int year, int month, int day) {
@@ -41,6 +43,10 @@ time_t Date::AsTimestamp() const {
   return mktime(&t);
 }
 
+int Date::AsDayNumber() const {
+  return DaysFromCivil(year_, month_, day_);
+}
+
 bool Date::Validate(int year, int month, int day) {
   if (month == 2 && day == 29) {
     return year % 4 == 0;
@@ -52,6 +58,17 @@ bool Date::Validate(int year, int month, int day) {
 }
 
 Date Date::FromString(const std::string& str) {
+  // Fast path for YYYY-MM-DD
+  if (str.size() == 10 && str[4] == '-' && str[7] == '-') {
+    const string_view view = str;
+    const int year = ParseDigits(view.substr(0, 4));
+    const int month = ParseDigits(view.substr(5, 2));
+    const int day = ParseDigits(view.substr(8, 2));
+    if (year >= 0 && month >= 0 && day >= 0) {
+      return {year, month, day};
+    }
+  }
+
   istringstream in{str};
   int year, month, day;
 
@@ -14,11 +14,14 @@ class Date {
   Date(int year, int month, int day);
 
   time_t AsTimestamp() const;
+  // Days since 1970-01-01
+  int AsDayNumber() const;
 
   static bool Validate(int year, int month, int day);
   static Date FromString(const std::string& str);
   static int ComputeDaysDiff(const Date& date_to, const Date& date_from);
   static Date Next(const Date& date);
+  static Date FromDayNumber(int day_number);
 
   int Year() const { return year_; }
   int Month() const { return month_; }
@@ -1,9 +1,7 @@
-#include <array>
-#include <cassert>
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
-#include <ctime>
 #include <iostream>
 #include <optional>
 #include <sstream>
@@ -11,6 +9,20 @@
 #include <string_view>
 #include <utility>
 
+#ifdef BUDGET_LEGACY_TEST
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "profile.h"
+#include "test_runner.h"
+#endif
+
+#include "civil_date.h"
+#include "lazy_segment_tree.h"
+
 using namespace std;
 
 pair<string_view, optional<string_view>> SplitTwoStrict(string_view s, string_view delimiter = " ") {
@@ -57,25 +69,26 @@ void ValidateBounds(Number number_to_check, Number min_value, Number max_value)
 class Date {
 public:
   static Date FromString(string_view str) {
-    const int year = ConvertToInt(ReadToken(str, "-"));
-    const int month = ConvertToInt(ReadToken(str, "-"));
+    int year = -1;
+    int month = -1;
+    int day = -1;
+    if (str.size() == 10 && str[4] == '-' && str[7] == '-') {
+      year = ParseDigits(str.substr(0, 4));
+      month = ParseDigits(str.substr(5, 2));
+      day = ParseDigits(str.substr(8, 2));
+    }
+    if (year < 0 || month < 0 || day < 0) {
+      year = ConvertToInt(ReadToken(str, "-"));
+      month = ConvertToInt(ReadToken(str, "-"));
+      day = ConvertToInt(str);
+    }
     ValidateBounds(month, 1, 12);
-    const int day = ConvertToInt(str);
     ValidateBounds(day, 1, 31);
     return {year, month, day};
   }
 
-  // Weird legacy, can't wait for std::chrono::year_month_day
-  time_t AsTimestamp() const {
-    std::tm t;
-    t.tm_sec  = 0;
-    t.tm_min  = 0;
-    t.tm_hour = 0;
-    t.tm_mday = day_;
-    t.tm_mon  = month_ - 1;
-    t.tm_year = year_ - 1900;
-    t.tm_isdst = 0;
-    return mktime(&t);
+  int AsDayNumber() const {
+    return DaysFromCivil(year_, month_, day_);
   }
 
 private:
@@ -89,163 +102,381 @@ private:
 };
 
 int ComputeDaysDiff(const Date& date_to, const Date& date_from) {
-  const time_t timestamp_to = date_to.AsTimestamp();
-  const time_t timestamp_from = date_from.AsTimestamp();
-  static constexpr int SECONDS_IN_DAY = 60 * 60 * 24;
-  return (timestamp_to - timestamp_from) / SECONDS_IN_DAY;
+  return date_to.AsDayNumber() - date_from.AsDayNumber();
 }
 
 static const Date START_DATE = Date::FromString("2000-01-01");
 static const Date END_DATE = Date::FromString("2100-01-01");
 static const size_t DAY_COUNT = ComputeDaysDiff(END_DATE, START_DATE);
-static const size_t DAY_COUNT_P2 = 1 << 16;
-static const size_t VERTEX_COUNT = DAY_COUNT_P2 * 2;
 
 size_t ComputeDayIndex(const Date& date) {
   return ComputeDaysDiff(date, START_DATE);
 }
 
 
-array<double, VERTEX_COUNT> tree_values, tree_spent_values, tree_add, tree_spent, tree_factor;
+struct BudgetValue {
+  double income = 0;
+  double spent = 0;
+};
 
-void Init() {
-  tree_values.fill(0);
-  tree_spent_values.fill(0);
-  tree_add.fill(0);
-  tree_spent.fill(0);
-  tree_factor.fill(1);
-}
+struct BudgetSums {
+  using Value = BudgetValue;
 
-void Push(size_t v, size_t l, size_t r) {
-  for (size_t w = v * 2; w <= v * 2 + 1; ++w) {
-    if (w < VERTEX_COUNT) {
-      tree_factor[w] *= tree_factor[v];
-      (tree_add[w] *= tree_factor[v]) += tree_add[v];
-      tree_spent[w] += tree_spent[v];
-      (tree_values[w] *= tree_factor[v]) += tree_add[v] * (r - l) / 2;
-      tree_spent_values[w] += tree_spent[v] * (r - l) / 2;
-    }
+  static Value Identity() {
+    return {};
   }
-  tree_factor[v] = 1;
-  tree_add[v] = 0;
-  tree_spent[v] = 0;
-}
 
-double ComputeSum(size_t v, size_t l, size_t r, size_t ql, size_t qr) {
-  if (v >= VERTEX_COUNT || qr <= l || r <= ql) {
-    return 0;
+  static Value Combine(const Value& lhs, const Value& rhs) {
+    return {lhs.income + rhs.income, lhs.spent + rhs.spent};
   }
-  Push(v, l, r);
-  if (ql <= l && r <= qr) {
-    return tree_values[v];
-  }
-  return ComputeSum(v * 2, l, (l + r) / 2, ql, qr)
-      + ComputeSum(v * 2 + 1, (l + r) / 2, r, ql, qr);
-}
+};
 
-double ComputeSpent(size_t v, size_t l, size_t r, size_t ql, size_t qr) {
-  if (v >= VERTEX_COUNT || qr <= l || r <= ql) {
-    return 0;
-  }
-  Push(v, l, r);
-  if (ql <= l && r <= qr) {
-    return tree_spent_values[v];
-  }
-  return ComputeSpent(v * 2, l, (l + r) / 2, ql, qr)
-      + ComputeSpent(v * 2 + 1, (l + r) / 2, r, ql, qr);
-}
+// Income of every day is multiplied by factor, then add is added to it
+struct BudgetUpdate {
+  double factor = 1;
+  double add = 0;
+  double spent = 0;
+};
 
-void Add(size_t v, size_t l, size_t r, size_t ql, size_t qr, double value) {
-  if (v >= VERTEX_COUNT || qr <= l || r <= ql) {
-    return;
+struct BudgetUpdates {
+  using Operation = BudgetUpdate;
+
+  static Operation Identity() {
+    return {};
   }
-  Push(v, l, r);
-  if (ql <= l && r <= qr) {
-    tree_add[v] += value;
-    tree_values[v] += value * (r - l);
-    return;
+
+  static Operation Compose(const Operation& earlier, const Operation& later) {
+    return {earlier.factor * later.factor,
+            earlier.add * later.factor + later.add,
+            earlier.spent + later.spent};
   }
-  Add(v * 2, l, (l + r) / 2, ql, qr, value);
-  Add(v * 2 + 1, (l + r) / 2, r, ql, qr, value);
-  tree_values[v] =
-      (v * 2 < VERTEX_COUNT ? tree_values[v * 2] : 0)
-      + (v * 2 + 1 < VERTEX_COUNT ? tree_values[v * 2 + 1] : 0);
-}
 
-void Spend(size_t v, size_t l, size_t r, size_t ql, size_t qr, double value) {
-  if (v >= VERTEX_COUNT || qr <= l || r <= ql) {
-    return;
+  static BudgetValue Apply(const Operation& operation, const BudgetValue& value, size_t length) {
+    return {value.income * operation.factor + operation.add * length,
+            value.spent + operation.spent * length};
   }
-  Push(v, l, r);
-  if (ql <= l && r <= qr) {
-    tree_spent[v] += value;
-    tree_spent_values[v] += value * (r - l);
-    return;
+};
+
+
+// Income and spendings by day, the last day, 2100-01-01, included
+class Budget {
+public:
+  explicit Budget(size_t size) : tree_(size) {}
+
+  size_t Size() const {
+    return tree_.Size();
   }
-  Spend(v * 2, l, (l + r) / 2, ql, qr, value);
-  Spend(v * 2 + 1, (l + r) / 2, r, ql, qr, value);
-  tree_spent_values[v] =
-      (v * 2 < VERTEX_COUNT ? tree_spent_values[v * 2] : 0)
-      + (v * 2 + 1 < VERTEX_COUNT ? tree_spent_values[v * 2 + 1] : 0);
-}
 
-void Multiply(size_t v, size_t l, size_t r, size_t ql, size_t qr, size_t percentage) {
-  if (v >= VERTEX_COUNT || qr <= l || r <= ql) {
-    return;
+  double ComputeIncome(size_t from, size_t to) const {
+    const auto sums = tree_.Fold(from, to);
+    return sums.income - sums.spent;
   }
-  double factor = 1.0 - percentage / 100.0;
-  Push(v, l, r);
-  if (ql <= l && r <= qr) {
-    tree_factor[v] *= factor;
-    tree_add[v] *= factor;
-    tree_values[v] *= factor;
-    return;
+
+  void PayTax(size_t from, size_t to, size_t percentage) {
+    tree_.Apply(from, to, {1.0 - percentage / 100.0, 0, 0});
   }
-  Multiply(v * 2, l, (l + r) / 2, ql, qr, percentage);
-  Multiply(v * 2 + 1, (l + r) / 2, r, ql, qr, percentage);
-  tree_values[v] =
-      (v * 2 < VERTEX_COUNT ? tree_values[v * 2] : 0)
-      + (v * 2 + 1 < VERTEX_COUNT ? tree_values[v * 2 + 1] : 0);
-}
 
+  void Earn(size_t from, size_t to, double daily_value) {
+    tree_.Apply(from, to, {1, daily_value, 0});
+  }
 
-int main() {
-  cout.precision(25);
-  assert(DAY_COUNT <= DAY_COUNT_P2 && DAY_COUNT_P2 < DAY_COUNT * 2);
+  void Spend(size_t from, size_t to, double daily_value) {
+    tree_.Apply(from, to, {1, 0, daily_value});
+  }
 
-  Init();
+private:
+  LazySegmentTree<BudgetSums, BudgetUpdates> tree_;
+};
 
+template <typename BudgetType>
+void ProcessQueries(BudgetType& budget, istream& input, ostream& output) {
   int q;
-  cin >> q;
+  input >> q;
 
   for (int i = 0; i < q; ++i) {
     string query_type;
-    cin >> query_type;
+    input >> query_type;
 
     string date_from_str, date_to_str;
-    cin >> date_from_str >> date_to_str;
+    input >> date_from_str >> date_to_str;
 
-    auto idx_from = ComputeDayIndex(Date::FromString(date_from_str));
-    auto idx_to = ComputeDayIndex(Date::FromString(date_to_str)) + 1;
+    auto idx_from = min(ComputeDayIndex(Date::FromString(date_from_str)), budget.Size());
+    auto idx_to = min(ComputeDayIndex(Date::FromString(date_to_str)) + 1, budget.Size());
 
     if (query_type == "ComputeIncome") {
-      auto total = ComputeSum(1, 0, DAY_COUNT_P2, idx_from, idx_to)
-          - ComputeSpent(1, 0, DAY_COUNT_P2, idx_from, idx_to);
-      cout << total << endl;
+      output << budget.ComputeIncome(idx_from, idx_to) << endl;
     } else if (query_type == "PayTax") {
       size_t percentage;
-      cin >> percentage;
-      Multiply(1, 0, DAY_COUNT_P2, idx_from, idx_to, percentage);
+      input >> percentage;
+      budget.PayTax(idx_from, idx_to, percentage);
     } else if (query_type == "Earn") {
       double value;
-      cin >> value;
-      Add(1, 0, DAY_COUNT_P2, idx_from, idx_to, value / (idx_to - idx_from));
+      input >> value;
+      budget.Earn(idx_from, idx_to, value / (idx_to - idx_from));
     } else if (query_type == "Spend") {
       double value;
-      cin >> value;
-      Spend(1, 0, DAY_COUNT_P2, idx_from, idx_to, value / (idx_to - idx_from));
+      input >> value;
+      budget.Spend(idx_from, idx_to, value / (idx_to - idx_from));
+    }
+  }
+}
+
+
+#ifdef BUDGET_LEGACY_TEST
+// The hand-tuned tree LazySegmentTree replaced: five arrays over a power of
+// two of days, node 1 is the root and node v has children 2v and 2v + 1,
+// every request descends recursively. Kept as the reference to test and
+// benchmark against
+class ArrayBudget {
+public:
+  explicit ArrayBudget(size_t size)
+      : size_(size), leaf_count_(ComputeLeafCount(size)), vertex_count_(2 * leaf_count_),
+        tree_values(vertex_count_, 0), tree_spent_values(vertex_count_, 0),
+        tree_add(vertex_count_, 0), tree_spent(vertex_count_, 0), tree_factor(vertex_count_, 1)
+  {}
+
+  size_t Size() const {
+    return size_;
+  }
+
+  double ComputeIncome(size_t from, size_t to) {
+    return ComputeSum(1, 0, leaf_count_, from, to) - ComputeSpent(1, 0, leaf_count_, from, to);
+  }
+
+  void PayTax(size_t from, size_t to, size_t percentage) {
+    Multiply(1, 0, leaf_count_, from, to, percentage);
+  }
+
+  void Earn(size_t from, size_t to, double daily_value) {
+    Add(1, 0, leaf_count_, from, to, daily_value);
+  }
+
+  void Spend(size_t from, size_t to, double daily_value) {
+    AddSpent(1, 0, leaf_count_, from, to, daily_value);
+  }
+
+private:
+  size_t size_;
+  size_t leaf_count_;
+  size_t vertex_count_;
+  vector<double> tree_values, tree_spent_values, tree_add, tree_spent, tree_factor;
+
+  static size_t ComputeLeafCount(size_t size) {
+    size_t leaf_count = 1;
+    while (leaf_count < size) {
+      leaf_count *= 2;
+    }
+    return leaf_count;
+  }
+
+  void Push(size_t v, size_t l, size_t r) {
+    for (size_t w = v * 2; w <= v * 2 + 1; ++w) {
+      if (w < vertex_count_) {
+        tree_factor[w] *= tree_factor[v];
+        (tree_add[w] *= tree_factor[v]) += tree_add[v];
+        tree_spent[w] += tree_spent[v];
+        (tree_values[w] *= tree_factor[v]) += tree_add[v] * (r - l) / 2;
+        tree_spent_values[w] += tree_spent[v] * (r - l) / 2;
+      }
+    }
+    tree_factor[v] = 1;
+    tree_add[v] = 0;
+    tree_spent[v] = 0;
+  }
+
+  double ComputeSum(size_t v, size_t l, size_t r, size_t ql, size_t qr) {
+    if (v >= vertex_count_ || qr <= l || r <= ql) {
+      return 0;
+    }
+    Push(v, l, r);
+    if (ql <= l && r <= qr) {
+      return tree_values[v];
+    }
+    return ComputeSum(v * 2, l, (l + r) / 2, ql, qr)
+        + ComputeSum(v * 2 + 1, (l + r) / 2, r, ql, qr);
+  }
+
+  double ComputeSpent(size_t v, size_t l, size_t r, size_t ql, size_t qr) {
+    if (v >= vertex_count_ || qr <= l || r <= ql) {
+      return 0;
+    }
+    Push(v, l, r);
+    if (ql <= l && r <= qr) {
+      return tree_spent_values[v];
+    }
+    return ComputeSpent(v * 2, l, (l + r) / 2, ql, qr)
+        + ComputeSpent(v * 2 + 1, (l + r) / 2, r, ql, qr);
+  }
+
+  void Add(size_t v, size_t l, size_t r, size_t ql, size_t qr, double value) {
+    if (v >= vertex_count_ || qr <= l || r <= ql) {
+      return;
+    }
+    Push(v, l, r);
+    if (ql <= l && r <= qr) {
+      tree_add[v] += value;
+      tree_values[v] += value * (r - l);
+      return;
+    }
+    Add(v * 2, l, (l + r) / 2, ql, qr, value);
+    Add(v * 2 + 1, (l + r) / 2, r, ql, qr, value);
+    tree_values[v] =
+        (v * 2 < vertex_count_ ? tree_values[v * 2] : 0)
+        + (v * 2 + 1 < vertex_count_ ? tree_values[v * 2 + 1] : 0);
+  }
+
+  void AddSpent(size_t v, size_t l, size_t r, size_t ql, size_t qr, double value) {
+    if (v >= vertex_count_ || qr <= l || r <= ql) {
+      return;
+    }
+    Push(v, l, r);
+    if (ql <= l && r <= qr) {
+      tree_spent[v] += value;
+      tree_spent_values[v] += value * (r - l);
+      return;
+    }
+    AddSpent(v * 2, l, (l + r) / 2, ql, qr, value);
+    AddSpent(v * 2 + 1, (l + r) / 2, r, ql, qr, value);
+    tree_spent_values[v] =
+        (v * 2 < vertex_count_ ? tree_spent_values[v * 2] : 0)
+        + (v * 2 + 1 < vertex_count_ ? tree_spent_values[v * 2 + 1] : 0);
+  }
+
+  void Multiply(size_t v, size_t l, size_t r, size_t ql, size_t qr, size_t percentage) {
+    if (v >= vertex_count_ || qr <= l || r <= ql) {
+      return;
+    }
+    double factor = 1.0 - percentage / 100.0;
+    Push(v, l, r);
+    if (ql <= l && r <= qr) {
+      tree_factor[v] *= factor;
+      tree_add[v] *= factor;
+      tree_values[v] *= factor;
+      return;
+    }
+    Multiply(v * 2, l, (l + r) / 2, ql, qr, percentage);
+    Multiply(v * 2 + 1, (l + r) / 2, r, ql, qr, percentage);
+    tree_values[v] =
+        (v * 2 < vertex_count_ ? tree_values[v * 2] : 0)
+        + (v * 2 + 1 < vertex_count_ ? tree_values[v * 2 + 1] : 0);
+  }
+};
+
+string MakeRandomDate(mt19937& generator) {
+  uniform_int_distribution<int> year{2000, 2099};
+  uniform_int_distribution<int> month{1, 12};
+  uniform_int_distribution<int> day{1, 28};
+  ostringstream date;
+  date << year(generator) << '-' << setw(2) << setfill('0') << month(generator)
+       << '-' << setw(2) << setfill('0') << day(generator);
+  return date.str();
+}
+
+// Input of count requests, 4 in 10 of them ComputeIncome and 1 in 10 PayTax
+string MakeRandomInput(size_t count, unsigned int seed) {
+  mt19937 generator{seed};
+  uniform_int_distribution<int> kind{0, 9};
+  uniform_int_distribution<int> amount{1, 1'000'000};
+  uniform_int_distribution<int> percentage{0, 99};
+  ostringstream input;
+  input << count << '\n';
+  for (size_t i = 0; i < count; ++i) {
+    string from = MakeRandomDate(generator);
+    string to = MakeRandomDate(generator);
+    if (to < from) {
+      swap(from, to);
+    }
+    const int k = kind(generator);
+    if (k < 4) {
+      input << "ComputeIncome " << from << ' ' << to << '\n';
+    } else if (k < 7) {
+      input << "Earn " << from << ' ' << to << ' ' << amount(generator) << '\n';
+    } else if (k < 9) {
+      input << "Spend " << from << ' ' << to << ' ' << amount(generator) << '\n';
+    } else {
+      input << "PayTax " << from << ' ' << to << ' ' << percentage(generator) << '\n';
+    }
+  }
+  return input.str();
+}
+
+template <typename BudgetType>
+vector<double> RunQueries(const string& input) {
+  BudgetType budget(DAY_COUNT + 1);
+  istringstream input_stream(input);
+  ostringstream output;
+  output.precision(25);
+  ProcessQueries(budget, input_stream, output);
+
+  vector<double> incomes;
+  istringstream output_stream(output.str());
+  for (double income; output_stream >> income;) {
+    incomes.push_back(income);
+  }
+  return incomes;
+}
+
+void TestBudgetMatchesArrayBudget() {
+  for (unsigned int seed = 1; seed <= 5; ++seed) {
+    const string input = MakeRandomInput(20'000, seed);
+    const auto expected = RunQueries<ArrayBudget>(input);
+    const auto incomes = RunQueries<Budget>(input);
+    ASSERT_EQUAL(incomes.size(), expected.size());
+    // The trees add in a different order, so the last digits may differ
+    for (size_t i = 0; i < incomes.size(); ++i) {
+      ASSERT(abs(incomes[i] - expected[i]) <= 1e-9 * max(1.0, abs(expected[i])));
     }
   }
+}
+
+void TestRequestsPastTheEnd() {
+  const string input =
+      "4\n"
+      "Earn 2099-12-31 2100-01-05 10\n"
+      "ComputeIncome 2100-01-01 2100-01-01\n"
+      "ComputeIncome 2100-01-02 2100-01-03\n"
+      "ComputeIncome 2099-01-01 2100-12-31\n";
+  const vector<double> expected = {5, 0, 10};
+  ASSERT_EQUAL(RunQueries<Budget>(input), expected);
+}
+
+void BenchmarkBudgets() {
+  const string input = MakeRandomInput(1'000'000, 42);
+  double array_checksum = 0;
+  double lazy_checksum = 0;
+  {
+    LOG_DURATION("Legacy array tree, 1M requests");
+    for (double income : RunQueries<ArrayBudget>(input)) {
+      array_checksum += income;
+    }
+  }
+  {
+    LOG_DURATION("LazySegmentTree, 1M requests");
+    for (double income : RunQueries<Budget>(input)) {
+      lazy_checksum += income;
+    }
+  }
+  cerr << "Budget benchmark checksum difference: " << lazy_checksum - array_checksum << endl;
+}
+
+void TestAll() {
+  TestRunner tr;
+  RUN_TEST(tr, TestBudgetMatchesArrayBudget);
+  RUN_TEST(tr, TestRequestsPastTheEnd);
+  BenchmarkBudgets();
+}
+#endif
+
+
+int main() {
+#ifdef BUDGET_LEGACY_TEST
+  TestAll();
+#endif
+
+  cout.precision(25);
+
+  Budget budget(DAY_COUNT + 1);
+  ProcessQueries(budget, cin, cout);
 
   return 0;
 }
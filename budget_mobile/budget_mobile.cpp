@@ -1,18 +1,40 @@
+#include <algorithm>
+#include <charconv>
+#include <cctype>
 #include <cmath>
 #include <cstdint>
-#include <ctime>
 #include <exception>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <stdexcept>
 #include <system_error>
+#include <tuple>
 #include <type_traits>
 #include <unordered_map>
+#include <variant>
 #include <vector>
 
+#ifdef BUDGET_MOBILE_TEST
+#include <atomic>
+#include <ctime>
+#include <future>
+#include <numeric>
+#include <random>
+
+#include "profile.h"
+#include "test_runner.h"
+#endif
+
+#include "civil_date.h"
+#include "lazy_segment_tree.h"
+
 using namespace std;
 
 template<typename It>
@@ -48,9 +70,15 @@ string_view ReadToken(string_view& s, string_view delimiter = " ") {
 }
 
 int ConvertToInt(string_view str) {
-  // use std::from_chars when available to git rid of string copy
+  int result = 0;
+  const auto [end, error] = from_chars(str.data(), str.data() + str.size(), result);
+  if (error == errc{} && end == str.data() + str.size()) {
+    return result;
+  }
+
+  // stoi also takes a leading plus and spaces, and explains errors
   size_t pos;
-  const int result = stoi(string(str), &pos);
+  result = stoi(string(str), &pos);
   if (pos != str.length()) {
     std::stringstream error;
     error << "string " << str << " contains " << (str.length() - pos) << " trailing chars";
@@ -137,6 +165,19 @@ public:
     tax_.factor *= other.tax_.factor;
   }
 
+  // Incomes are not scaled, the operation only adds and spends
+  bool IsAdditive() const {
+    return tax_.ComputeFactor() == 1.0;
+  }
+
+  double GetDailyIncome() const {
+    return add_.delta;
+  }
+
+  double GetDailySpending() const {
+    return spent_.delta;
+  }
+
   pair<double, double> Collapse(double original_income, double original_spent,
                                 IndexSegment segment) const {
     return {original_income * tax_.ComputeFactor() + add_.delta * segment.length(),
@@ -151,73 +192,311 @@ private:
 };
 
 
+// Money as a whole number of millionths. Sums are exact, so they do not
+// depend on the order of additions or on the shape of a tree; only scaling
+// by a tax factor rounds, to the nearest millionth.
+class FixedMoney {
+public:
+  static constexpr int64_t UNITS_PER_ONE = 1'000'000;
+
+  constexpr FixedMoney() = default;
+
+  static constexpr FixedMoney FromUnits(int64_t units) {
+    FixedMoney money;
+    money.units_ = units;
+    return money;
+  }
+
+  static FixedMoney FromDouble(double value) {
+    return FromUnits(llround(value * UNITS_PER_ONE));
+  }
+
+  constexpr int64_t GetUnits() const {
+    return units_;
+  }
+
+  explicit operator double() const {
+    return static_cast<double>(units_) / UNITS_PER_ONE;
+  }
+
+  FixedMoney& operator+=(FixedMoney other) {
+    units_ += other.units_;
+    return *this;
+  }
+
+  FixedMoney& operator-=(FixedMoney other) {
+    units_ -= other.units_;
+    return *this;
+  }
+
+  friend FixedMoney operator+(FixedMoney lhs, FixedMoney rhs) {
+    return lhs += rhs;
+  }
+
+  friend FixedMoney operator-(FixedMoney lhs, FixedMoney rhs) {
+    return lhs -= rhs;
+  }
+
+  friend FixedMoney operator*(FixedMoney money, size_t count) {
+    return FromUnits(money.units_ * static_cast<int64_t>(count));
+  }
+
+  friend bool operator==(FixedMoney lhs, FixedMoney rhs) {
+    return lhs.units_ == rhs.units_;
+  }
+
+private:
+  int64_t units_ = 0;
+};
+
+ostream& operator<<(ostream& stream, FixedMoney money) {
+  const int64_t units = money.GetUnits();
+  const uint64_t abs_units = units < 0 ? 0 - static_cast<uint64_t>(units) : units;
+  const char fill = stream.fill('0');
+  stream << (units < 0 ? "-" : "") << abs_units / FixedMoney::UNITS_PER_ONE
+         << '.' << setw(6) << abs_units % FixedMoney::UNITS_PER_ONE;
+  stream.fill(fill);
+  return stream;
+}
+
+// Product of tax factors in units of 10^-12, 0.87 is stored exactly
+class FixedFactor {
+public:
+  static constexpr int64_t UNITS_PER_ONE = 1'000'000'000'000;
+
+  static FixedFactor FromDouble(double factor) {
+    return FixedFactor{llround(factor * UNITS_PER_ONE)};
+  }
+
+  FixedFactor() = default;
+
+  // Most postponed operations carry no tax, and 128-bit division is slow
+  bool IsOne() const {
+    return units_ == UNITS_PER_ONE;
+  }
+
+  FixedFactor& operator*=(FixedFactor other) {
+    if (!other.IsOne()) {
+      units_ = MultiplyRounded(units_, other.units_);
+    }
+    return *this;
+  }
+
+  FixedMoney Apply(FixedMoney money) const {
+    return IsOne() ? money : FixedMoney::FromUnits(MultiplyRounded(money.GetUnits(), units_));
+  }
+
+private:
+  int64_t units_ = UNITS_PER_ONE;
+
+  explicit FixedFactor(int64_t units) : units_(units) {}
+
+  // value * units_ / UNITS_PER_ONE rounded half away from zero, the product
+  // does not fit in 64 bits
+  static int64_t MultiplyRounded(int64_t value, int64_t units) {
+    const __int128 product = static_cast<__int128>(value) * units;
+    const __int128 half = product < 0 ? -UNITS_PER_ONE / 2 : UNITS_PER_ONE / 2;
+    return static_cast<int64_t>((product + half) / UNITS_PER_ONE);
+  }
+};
+
+// BulkLinearUpdater over fixed-point money, made from the same operations
+class FixedLinearUpdater {
+public:
+  FixedLinearUpdater() = default;
+
+  FixedLinearUpdater(const BulkMoneyAdder& add)
+      : add_(FixedMoney::FromDouble(add.delta))
+  {}
+
+  FixedLinearUpdater(const BulkMoneySpender& spend)
+      : spent_(FixedMoney::FromDouble(spend.delta))
+  {}
+
+  FixedLinearUpdater(const BulkTaxApplier& tax)
+      : tax_(FixedFactor::FromDouble(tax.factor))
+  {}
+
+  void CombineWith(const FixedLinearUpdater& other) {
+    add_ = other.tax_.Apply(add_) + other.add_;
+    spent_ += other.spent_;
+    tax_ *= other.tax_;
+  }
+
+  pair<FixedMoney, FixedMoney> Collapse(FixedMoney original_income, FixedMoney original_spent,
+                                        IndexSegment segment) const {
+    return {tax_.Apply(original_income) + add_ * segment.length(),
+            original_spent + spent_ * segment.length()};
+  }
+
+private:
+  // apply tax first, then add
+  FixedFactor tax_;
+  FixedMoney add_;
+  FixedMoney spent_;
+};
+
+
+// Incomes and spendings of a segment of days
+template <typename Data>
+struct BudgetSums {
+  struct Value {
+    Data data{};
+    Data spent{};
+  };
+
+  static Value Identity() {
+    return {};
+  }
+
+  static Value Combine(const Value& lhs, const Value& rhs) {
+    return {lhs.data + rhs.data, lhs.spent + rhs.spent};
+  }
+};
+
+template <typename Data, typename BulkOperation>
+struct BudgetBulkOperations {
+  using Operation = BulkOperation;
+  using Value = typename BudgetSums<Data>::Value;
+
+  static Operation Identity() {
+    return {};
+  }
+
+  static Operation Compose(Operation earlier, const Operation& later) {
+    earlier.CombineWith(later);
+    return earlier;
+  }
+
+  static Value Apply(const Operation& operation, const Value& value, size_t length) {
+    const auto [data, spent] = operation.Collapse(value.data, value.spent, {0, length});
+    return {data, spent};
+  }
+};
+
+// Budget over the shared lazy segment tree; segments outside of the tree are
+// cut to it
 template <typename Data, typename BulkOperation>
 class SummingSegmentTree {
 public:
-  SummingSegmentTree(size_t size) : root_(Build({0, size})) {}
+  SummingSegmentTree(size_t size) : tree_(size) {}
+
+  // Tree over the given values of every position
+  SummingSegmentTree(const vector<Data>& data, const vector<Data>& spent)
+      : tree_(MakeValues(data, spent))
+  {}
 
   Data ComputeSum(IndexSegment segment) const {
-    return this->TraverseWithQuery(root_, segment, ComputeSumVisitor{});
+    segment = Clamp(segment);
+    const auto sums = tree_.Fold(segment.left, segment.right);
+    return sums.data - sums.spent;
   }
 
   void AddBulkOperation(IndexSegment segment, const BulkOperation& operation) {
-    this->TraverseWithQuery(root_, segment, AddBulkOperationVisitor{operation});
+    segment = Clamp(segment);
+    tree_.Apply(segment.left, segment.right, operation);
   }
 
 private:
-  struct Node;
-  using NodeHolder = unique_ptr<Node>;
+  using Sums = BudgetSums<Data>;
+
+  LazySegmentTree<Sums, BudgetBulkOperations<Data, BulkOperation>> tree_;
+
+  IndexSegment Clamp(IndexSegment segment) const {
+    return IntersectSegments(segment, {0, tree_.Size()});
+  }
+
+  static vector<typename Sums::Value> MakeValues(const vector<Data>& data, const vector<Data>& spent) {
+    vector<typename Sums::Value> values(data.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+      values[i] = {data[i], spent[i]};
+    }
+    return values;
+  }
+};
+
+
+// Segment tree for many small budgets: nodes come from a pool shared by all
+// trees and are created only when a request splits their parent, so an
+// untouched subtree is just a missing child. Postponed operations stay on
+// nodes without children until such a split.
+template <typename Data, typename BulkOperation>
+class SparseSummingSegmentTree {
+public:
+  using NodeId = uint32_t;
 
   struct Node {
-    NodeHolder left;
-    NodeHolder right;
-    IndexSegment segment;
-    Data data;
-    Data spent;
+    Data data{};
+    Data spent{};
     BulkOperation postponed_bulk_operation;
+    NodeId left = NO_NODE;
+    NodeId right = NO_NODE;
   };
 
-  NodeHolder root_;
+  // Node 0 stands for a missing child
+  class NodePool {
+  public:
+    NodePool() : nodes_(1) {}
 
-  static NodeHolder Build(IndexSegment segment) {
-    if (segment.empty()) {
-      return nullptr;
-    } else if (segment.length() == 1) {
-      return make_unique<Node>(Node{
-        .left = nullptr,
-        .right = nullptr,
-        .segment = segment,
-      });
-    } else {
-      const size_t middle = segment.left + segment.length() / 2;
-      return make_unique<Node>(Node{
-        .left = Build({segment.left, middle}),
-        .right = Build({middle, segment.right}),
-        .segment = segment,
-      });
+    NodeId Allocate() {
+      if (nodes_.size() > numeric_limits<NodeId>::max()) {
+        throw length_error("Segment tree node pool is exhausted");
+      }
+      nodes_.emplace_back();
+      return static_cast<NodeId>(nodes_.size() - 1);
     }
+
+    Node& operator[](NodeId id) { return nodes_[id]; }
+    const Node& operator[](NodeId id) const { return nodes_[id]; }
+
+    size_t Size() const { return nodes_.size() - 1; }
+    size_t MemoryUsage() const { return nodes_.capacity() * sizeof(Node); }
+
+  private:
+    vector<Node> nodes_;
+  };
+
+  SparseSummingSegmentTree(NodePool& pool, size_t size)
+      : pool_(&pool), size_(size), root_(pool.Allocate())
+  {}
+
+  Data ComputeSum(IndexSegment segment) const {
+    return this->TraverseWithQuery(root_, {0, size_}, segment, ComputeSumVisitor{*pool_});
+  }
+
+  void AddBulkOperation(IndexSegment segment, const BulkOperation& operation) {
+    this->TraverseWithQuery(root_, {0, size_}, segment, AddBulkOperationVisitor{*pool_, operation});
   }
 
+private:
+  static constexpr NodeId NO_NODE = 0;
+
+  // Queries split nodes as well, so even const trees write into the pool
+  NodePool* pool_;
+  size_t size_;
+  NodeId root_;
+
   template <typename Visitor>
-  static typename Visitor::ResultType TraverseWithQuery(const NodeHolder& node, IndexSegment query_segment, Visitor visitor) {
-    if (!node || !AreSegmentsIntersected(node->segment, query_segment)) {
+  typename Visitor::ResultType TraverseWithQuery(NodeId node, IndexSegment node_segment, IndexSegment query_segment, Visitor visitor) const {
+    if (node_segment.empty() || !AreSegmentsIntersected(node_segment, query_segment)) {
       return visitor.ProcessEmpty(node);
+    } else if (query_segment.Contains(node_segment)) {
+      return visitor.ProcessFull(node, node_segment);
     } else {
-      PropagateBulkOperation(node);
-      if (query_segment.Contains(node->segment)) {
-        return visitor.ProcessFull(node);
+      PropagateBulkOperation(node, node_segment);
+      const size_t middle = node_segment.left + node_segment.length() / 2;
+      const NodeId left = (*pool_)[node].left;
+      const NodeId right = (*pool_)[node].right;
+      if constexpr (is_void_v<typename Visitor::ResultType>) {
+        TraverseWithQuery(left, {node_segment.left, middle}, query_segment, visitor);
+        TraverseWithQuery(right, {middle, node_segment.right}, query_segment, visitor);
+        return visitor.ProcessPartial(node, query_segment);
       } else {
-        if constexpr (is_void_v<typename Visitor::ResultType>) {
-          TraverseWithQuery(node->left, query_segment, visitor);
-          TraverseWithQuery(node->right, query_segment, visitor);
-          return visitor.ProcessPartial(node, query_segment);
-        } else {
-          return visitor.ProcessPartial(
-              node, query_segment,
-              TraverseWithQuery(node->left, query_segment, visitor),
-              TraverseWithQuery(node->right, query_segment, visitor)
-          );
-        }
+        return visitor.ProcessPartial(
+            node, query_segment,
+            TraverseWithQuery(left, {node_segment.left, middle}, query_segment, visitor),
+            TraverseWithQuery(right, {middle, node_segment.right}, query_segment, visitor)
+        );
       }
     }
   }
@@ -226,51 +505,196 @@ private:
   public:
     using ResultType = Data;
 
-    Data ProcessEmpty(const NodeHolder&) const {
+    explicit ComputeSumVisitor(const NodePool& pool)
+        : pool_(pool)
+    {}
+
+    Data ProcessEmpty(NodeId) const {
       return {};
     }
 
-    Data ProcessFull(const NodeHolder& node) const {
-      return node->data - node->spent;
+    Data ProcessFull(NodeId node, IndexSegment) const {
+      return pool_[node].data - pool_[node].spent;
     }
 
-    Data ProcessPartial(const NodeHolder&, IndexSegment, const Data& left_result, const Data& right_result) const {
+    Data ProcessPartial(NodeId, IndexSegment, const Data& left_result, const Data& right_result) const {
       return left_result + right_result;
     }
+
+  private:
+    const NodePool& pool_;
   };
 
   class AddBulkOperationVisitor {
   public:
     using ResultType = void;
 
-    explicit AddBulkOperationVisitor(const BulkOperation& operation)
-        : operation_(operation)
+    AddBulkOperationVisitor(NodePool& pool, const BulkOperation& operation)
+        : pool_(pool)
+        , operation_(operation)
     {}
 
-    void ProcessEmpty(const NodeHolder&) const {}
+    void ProcessEmpty(NodeId) const {}
 
-    void ProcessFull(const NodeHolder& node) const {
-      node->postponed_bulk_operation.CombineWith(operation_);
-      tie(node->data, node->spent) = operation_.Collapse(node->data, node->spent, node->segment);
+    void ProcessFull(NodeId node, IndexSegment segment) const {
+      auto& full_node = pool_[node];
+      full_node.postponed_bulk_operation.CombineWith(operation_);
+      tie(full_node.data, full_node.spent) = operation_.Collapse(full_node.data, full_node.spent, segment);
     }
 
-    void ProcessPartial(const NodeHolder& node, IndexSegment) const {
-      node->data = (node->left ? node->left->data : Data()) + (node->right ? node->right->data : Data());
-      node->spent = (node->left ? node->left->spent : Data()) + (node->right ? node->right->spent : Data());
+    void ProcessPartial(NodeId node, IndexSegment) const {
+      auto& partial_node = pool_[node];
+      const auto& left = pool_[partial_node.left];
+      const auto& right = pool_[partial_node.right];
+      partial_node.data = left.data + right.data;
+      partial_node.spent = left.spent + right.spent;
     }
 
   private:
+    NodePool& pool_;
     const BulkOperation& operation_;
   };
 
-  static void PropagateBulkOperation(const NodeHolder& node) {
-    for (auto* child_ptr : {node->left.get(), node->right.get()}) {
-      if (child_ptr) {
-        child_ptr->postponed_bulk_operation.CombineWith(node->postponed_bulk_operation);
-        std::tie(child_ptr->data, child_ptr->spent) = node->postponed_bulk_operation.Collapse(child_ptr->data, child_ptr->spent, child_ptr->segment);
+  // Called for nodes longer than one day only
+  void PropagateBulkOperation(NodeId node, IndexSegment segment) const {
+    if ((*pool_)[node].left == NO_NODE) {
+      // Allocation may move the pool, node references are taken afterwards
+      const NodeId left = pool_->Allocate();
+      const NodeId right = pool_->Allocate();
+      (*pool_)[node].left = left;
+      (*pool_)[node].right = right;
+    }
+
+    auto& parent = (*pool_)[node];
+    const size_t middle = segment.left + segment.length() / 2;
+    const pair<NodeId, IndexSegment> children[] = {
+      {parent.left, {segment.left, middle}},
+      {parent.right, {middle, segment.right}},
+    };
+    for (const auto& [child, child_segment] : children) {
+      auto& child_node = (*pool_)[child];
+      child_node.postponed_bulk_operation.CombineWith(parent.postponed_bulk_operation);
+      std::tie(child_node.data, child_node.spent) =
+          parent.postponed_bulk_operation.Collapse(child_node.data, child_node.spent, child_segment);
+    }
+    parent.postponed_bulk_operation = BulkOperation();
+  }
+};
+
+
+// Segment tree with path copying: an update copies the nodes on its way and
+// leaves the previous version untouched, so a snapshot can be queried from
+// any number of threads while the writer builds the next version. Queries
+// never push postponed operations down, they carry them along the descent.
+// Missing children stand for untouched subtrees, as in the sparse tree.
+template <typename Data, typename BulkOperation>
+class PersistentSummingSegmentTree {
+private:
+  struct Node;
+  using NodeHolder = shared_ptr<const Node>;
+
+  struct Node {
+    Data data{};
+    Data spent{};
+    BulkOperation postponed_bulk_operation;
+    NodeHolder left;
+    NodeHolder right;
+  };
+
+public:
+  class Snapshot {
+  public:
+    Data ComputeSum(IndexSegment segment) const {
+      return ComputeSum(root_.get(), {0, size_}, segment, BulkOperation());
+    }
+
+  private:
+    friend class PersistentSummingSegmentTree;
+
+    Snapshot(NodeHolder root, size_t size)
+        : root_(move(root))
+        , size_(size)
+    {}
+
+    NodeHolder root_;
+    size_t size_;
+
+    // pending is the composition of the operations postponed above the node
+    static Data ComputeSum(const Node* node, IndexSegment node_segment, IndexSegment query_segment,
+                           const BulkOperation& pending) {
+      if (node_segment.empty() || !AreSegmentsIntersected(node_segment, query_segment)) {
+        return {};
+      } else if (!node) {
+        const auto [data, spent] = pending.Collapse({}, {}, IntersectSegments(node_segment, query_segment));
+        return data - spent;
+      } else if (query_segment.Contains(node_segment)) {
+        const auto [data, spent] = pending.Collapse(node->data, node->spent, node_segment);
+        return data - spent;
       }
+
+      // Operations postponed at the node are older than the ones above it
+      BulkOperation child_pending = node->postponed_bulk_operation;
+      child_pending.CombineWith(pending);
+      const size_t middle = node_segment.left + node_segment.length() / 2;
+      return ComputeSum(node->left.get(), {node_segment.left, middle}, query_segment, child_pending)
+           + ComputeSum(node->right.get(), {middle, node_segment.right}, query_segment, child_pending);
     }
-    node->postponed_bulk_operation = BulkOperation();
+  };
+
+  explicit PersistentSummingSegmentTree(size_t size)
+      : size_(size)
+      , root_(make_shared<const Node>())
+  {}
+
+  Data ComputeSum(IndexSegment segment) const {
+    return GetSnapshot().ComputeSum(segment);
+  }
+
+  void AddBulkOperation(IndexSegment segment, const BulkOperation& operation) {
+    root_ = AddBulkOperation(root_, {0, size_}, segment, operation);
+  }
+
+  Snapshot GetSnapshot() const {
+    return {root_, size_};
+  }
+
+private:
+  size_t size_;
+  NodeHolder root_;
+
+  static shared_ptr<Node> CopyNode(const NodeHolder& node) {
+    return node ? make_shared<Node>(*node) : make_shared<Node>();
+  }
+
+  static NodeHolder ApplyBulkOperation(const NodeHolder& node, IndexSegment segment, const BulkOperation& operation) {
+    auto result = CopyNode(node);
+    result->postponed_bulk_operation.CombineWith(operation);
+    tie(result->data, result->spent) = operation.Collapse(result->data, result->spent, segment);
+    return result;
+  }
+
+  static NodeHolder AddBulkOperation(const NodeHolder& node, IndexSegment node_segment, IndexSegment query_segment,
+                                     const BulkOperation& operation) {
+    if (node_segment.empty() || !AreSegmentsIntersected(node_segment, query_segment)) {
+      return node;
+    } else if (query_segment.Contains(node_segment)) {
+      return ApplyBulkOperation(node, node_segment, operation);
+    }
+
+    auto result = CopyNode(node);
+    const size_t middle = node_segment.left + node_segment.length() / 2;
+    const IndexSegment left_segment{node_segment.left, middle};
+    const IndexSegment right_segment{middle, node_segment.right};
+    result->left = AddBulkOperation(
+        ApplyBulkOperation(result->left, left_segment, result->postponed_bulk_operation),
+        left_segment, query_segment, operation);
+    result->right = AddBulkOperation(
+        ApplyBulkOperation(result->right, right_segment, result->postponed_bulk_operation),
+        right_segment, query_segment, operation);
+    result->postponed_bulk_operation = BulkOperation();
+    result->data = result->left->data + result->right->data;
+    result->spent = result->left->spent + result->right->spent;
+    return result;
   }
 };
 
@@ -278,25 +702,27 @@ private:
 class Date {
 public:
   static Date FromString(string_view str) {
-    const int year = ConvertToInt(ReadToken(str, "-"));
-    const int month = ConvertToInt(ReadToken(str, "-"));
+    int year = -1;
+    int month = -1;
+    int day = -1;
+    // Requests always use YYYY-MM-DD, other spellings take the slow path
+    if (str.size() == 10 && str[4] == '-' && str[7] == '-') {
+      year = ParseDigits(str.substr(0, 4));
+      month = ParseDigits(str.substr(5, 2));
+      day = ParseDigits(str.substr(8, 2));
+    }
+    if (year < 0 || month < 0 || day < 0) {
+      year = ConvertToInt(ReadToken(str, "-"));
+      month = ConvertToInt(ReadToken(str, "-"));
+      day = ConvertToInt(str);
+    }
     ValidateBounds(month, 1, 12);
-    const int day = ConvertToInt(str);
     ValidateBounds(day, 1, 31);
     return {year, month, day};
   }
 
-  // Weird legacy, can't wait for std::chrono::year_month_day
-  time_t AsTimestamp() const {
-    std::tm t;
-    t.tm_sec  = 0;
-    t.tm_min  = 0;
-    t.tm_hour = 0;
-    t.tm_mday = day_;
-    t.tm_mon  = month_ - 1;
-    t.tm_year = year_ - 1900;
-    t.tm_isdst = 0;
-    return mktime(&t);
+  int AsDayNumber() const {
+    return DaysFromCivil(year_, month_, day_);
   }
 
 private:
@@ -310,10 +736,7 @@ private:
 };
 
 int ComputeDaysDiff(const Date& date_to, const Date& date_from) {
-  const time_t timestamp_to = date_to.AsTimestamp();
-  const time_t timestamp_from = date_from.AsTimestamp();
-  static constexpr int SECONDS_IN_DAY = 60 * 60 * 24;
-  return (timestamp_to - timestamp_from) / SECONDS_IN_DAY;
+  return date_to.AsDayNumber() - date_from.AsDayNumber();
 }
 
 static const Date START_DATE = Date::FromString("2000-01-01");
@@ -328,137 +751,326 @@ IndexSegment MakeDateSegment(const Date& date_from, const Date& date_to) {
   return {ComputeDayIndex(date_from), ComputeDayIndex(date_to) + 1};
 }
 
+// Days of the segment within the calendar; an empty segment becomes [0, 0),
+// so its bounds are valid indices too
+IndexSegment ClampToCalendar(IndexSegment segment) {
+  const IndexSegment days = IntersectSegments(segment, {0, DAY_COUNT});
+  return days.empty() ? IndexSegment{0, 0} : days;
+}
+
 
-class BudgetManager : public SummingSegmentTree<double, BulkLinearUpdater> {
+// Range additions and range sums over two Fenwick trees of differences: the
+// sum over [0, i) is i * D(i) - W(i), where D sums the differences before i
+// and W sums them weighted by their positions
+template <typename Data>
+class RangeFenwickTree {
 public:
-    BudgetManager() : SummingSegmentTree(DAY_COUNT) {}
-};
+  explicit RangeFenwickTree(size_t size)
+      : differences_(size + 1)
+      , weighted_differences_(size + 1)
+  {}
 
+  void Add(IndexSegment segment, Data value) {
+    AddDifference(segment.left, value);
+    AddDifference(segment.right, -value);
+  }
 
-struct Request;
-using RequestHolder = unique_ptr<Request>;
+  Data ComputeSum(IndexSegment segment) const {
+    return ComputePrefixSum(segment.right) - ComputePrefixSum(segment.left);
+  }
 
-struct Request {
-  enum class Type {
-    COMPUTE_INCOME,
-    EARN,
-    SPEND,
-    PAY_TAX
-  };
+  Data GetValue(size_t position) const {
+    return Sum(differences_, position + 1);
+  }
 
-  Request(Type type) : type(type) {}
-  static RequestHolder Create(Type type);
-  virtual void ParseFrom(string_view input) = 0;
-  virtual ~Request() = default;
+  size_t Size() const {
+    return differences_.size() - 1;
+  }
 
-  const Type type;
-};
+private:
+  // Position i is stored at index i + 1
+  vector<Data> differences_;
+  vector<Data> weighted_differences_;
 
-const unordered_map<string_view, Request::Type> STR_TO_REQUEST_TYPE = {
-    {"ComputeIncome", Request::Type::COMPUTE_INCOME},
-    {"Earn", Request::Type::EARN},
-    {"Spend", Request::Type::SPEND},
-    {"PayTax", Request::Type::PAY_TAX},
-};
+  static size_t LowestBit(size_t index) {
+    return index & (~index + 1);
+  }
 
-template <typename ResultType>
-struct ReadRequest : Request {
-  using Request::Request;
-  virtual ResultType Process(const BudgetManager& manager) const = 0;
-};
+  void AddDifference(size_t position, Data value) {
+    const Data weighted_value = value * position;
+    for (size_t index = position + 1; index < differences_.size(); index += LowestBit(index)) {
+      differences_[index] += value;
+      weighted_differences_[index] += weighted_value;
+    }
+  }
+
+  static Data Sum(const vector<Data>& tree, size_t count) {
+    Data result{};
+    for (size_t index = count; index > 0; index -= LowestBit(index)) {
+      result += tree[index];
+    }
+    return result;
+  }
 
-struct ModifyRequest : Request {
-  using Request::Request;
-  virtual void Process(BudgetManager& manager) const = 0;
+  Data ComputePrefixSum(size_t count) const {
+    return Sum(differences_, count) * count - Sum(weighted_differences_, count);
+  }
 };
 
-struct ComputeIncomeRequest : ReadRequest<double> {
-  ComputeIncomeRequest() : ReadRequest(Type::COMPUTE_INCOME) {}
-  void ParseFrom(string_view input) override {
-    date_from = Date::FromString(ReadToken(input));
-    date_to = Date::FromString(input);
+
+// Budget on one of two backends. Without taxes incomes and spendings only
+// add up, which Fenwick trees handle in a flat array; the first tax moves
+// the budget to the lazy segment tree, built from the current daily values.
+class BudgetManager {
+public:
+  enum class Backend {
+    FENWICK_TREES,
+    SEGMENT_TREE,
+  };
+
+  explicit BudgetManager(Backend backend = Backend::SEGMENT_TREE) {
+    if (backend == Backend::SEGMENT_TREE) {
+      backend_.emplace<SegmentTree>(DAY_COUNT);
+    }
+  }
+
+  Backend GetBackend() const {
+    return holds_alternative<AdditiveBudget>(backend_) ? Backend::FENWICK_TREES : Backend::SEGMENT_TREE;
+  }
+
+  double ComputeSum(IndexSegment segment) const {
+    segment = ClampToCalendar(segment);
+    if (const auto* budget = get_if<AdditiveBudget>(&backend_)) {
+      return static_cast<double>(budget->income.ComputeSum(segment) - budget->spent.ComputeSum(segment));
+    }
+    return get<SegmentTree>(backend_).ComputeSum(segment);
   }
 
-  double Process(const BudgetManager& manager) const override {
-    return manager.ComputeSum(MakeDateSegment(date_from, date_to));
+  void AddBulkOperation(IndexSegment segment, const BulkLinearUpdater& operation) {
+    segment = ClampToCalendar(segment);
+    if (auto* budget = get_if<AdditiveBudget>(&backend_)) {
+      if (operation.IsAdditive()) {
+        if (const double income = operation.GetDailyIncome(); income != 0) {
+          budget->income.Add(segment, income);
+        }
+        if (const double spending = operation.GetDailySpending(); spending != 0) {
+          budget->spent.Add(segment, spending);
+        }
+        return;
+      }
+      SwitchToSegmentTree();
+    }
+    get<SegmentTree>(backend_).AddBulkOperation(segment, operation);
   }
 
-  Date date_from = START_DATE;
-  Date date_to = START_DATE;
+private:
+  using SegmentTree = SummingSegmentTree<double, BulkLinearUpdater>;
+
+  struct AdditiveBudget {
+    AdditiveBudget() : income(DAY_COUNT), spent(DAY_COUNT) {}
+
+    // long double keeps the differences of large prefix sums exact enough
+    RangeFenwickTree<long double> income;
+    RangeFenwickTree<long double> spent;
+  };
+
+  variant<AdditiveBudget, SegmentTree> backend_;
+
+  void SwitchToSegmentTree() {
+    const auto& budget = get<AdditiveBudget>(backend_);
+    vector<double> income(DAY_COUNT);
+    vector<double> spent(DAY_COUNT);
+    for (size_t day = 0; day < DAY_COUNT; ++day) {
+      income[day] = static_cast<double>(budget.income.GetValue(day));
+      spent[day] = static_cast<double>(budget.spent.GetValue(day));
+    }
+    backend_.emplace<SegmentTree>(income, spent);
+  }
 };
 
-struct EarnRequest : ModifyRequest {
-  EarnRequest() : ModifyRequest(Type::EARN) {}
-  void ParseFrom(string_view input) override {
-    date_from = Date::FromString(ReadToken(input));
-    date_to = Date::FromString(ReadToken(input));
-    income = ConvertToInt(input);
+
+// One writer, many readers: modifications go to the writer's own version,
+// readers query the last published snapshot without locking the tree
+class PublishingBudgetManager {
+public:
+  using Tree = PersistentSummingSegmentTree<double, BulkLinearUpdater>;
+
+  PublishingBudgetManager()
+      : tree_(DAY_COUNT)
+      , published_(tree_.GetSnapshot())
+  {}
+
+  // Sees the published version only
+  double ComputeSum(IndexSegment segment) const {
+    return GetSnapshot().ComputeSum(segment);
+  }
+
+  void AddBulkOperation(IndexSegment segment, const BulkLinearUpdater& operation) {
+    tree_.AddBulkOperation(segment, operation);
+  }
+
+  void Publish() {
+    auto snapshot = tree_.GetSnapshot();
+    lock_guard<mutex> lock(published_mutex_);
+    swap(published_, snapshot);
   }
 
-  void Process(BudgetManager& manager) const override {
-    const auto date_segment = MakeDateSegment(date_from, date_to);
-    const double daily_income = income * 1.0 / date_segment.length();
-    manager.AddBulkOperation(date_segment, BulkMoneyAdder{daily_income});
+  Tree::Snapshot GetSnapshot() const {
+    lock_guard<mutex> lock(published_mutex_);
+    return published_;
   }
 
-  Date date_from = START_DATE;
-  Date date_to = START_DATE;
-  size_t income = 0;
+private:
+  Tree tree_;
+  mutable mutex published_mutex_;
+  Tree::Snapshot published_;
 };
 
-struct SpendRequest : ModifyRequest {
-  SpendRequest () : ModifyRequest(Type::SPEND) {}
-  void ParseFrom(string_view input) override {
-    date_from = Date::FromString(ReadToken(input));
-    date_to = Date::FromString(ReadToken(input));
-    spend = ConvertToInt(input);
+
+using AccountId = uint64_t;
+constexpr AccountId DEFAULT_ACCOUNT = 0;
+
+// Budgets of many accounts in one process. A new account keeps a short log
+// of its operations and answers queries by replaying it over the days
+// between the operation bounds; past SMALL_ACCOUNT_OPERATIONS the log is
+// moved into a sparse tree whose nodes come from the shared pool.
+class MultiAccountBudgetManager {
+public:
+  static constexpr size_t SMALL_ACCOUNT_OPERATIONS = 8;
+
+  double ComputeSum(AccountId account_id, IndexSegment segment) const {
+    const auto it = accounts_.find(account_id);
+    if (it == accounts_.end()) {
+      return 0;
+    }
+    const auto& account = it->second;
+    return account.tree ? account.tree->ComputeSum(segment) : ComputeLoggedSum(account.log, ClampToCalendar(segment));
   }
 
-  void Process(BudgetManager& manager) const override {
-    const auto date_segment = MakeDateSegment(date_from, date_to);
-    const double daily_spend = spend * 1.0 / date_segment.length();
-    manager.AddBulkOperation(date_segment, BulkMoneySpender{daily_spend});
+  void AddBulkOperation(AccountId account_id, IndexSegment segment, const BulkLinearUpdater& operation) {
+    auto& account = accounts_[account_id];
+    if (account.tree) {
+      account.tree->AddBulkOperation(segment, operation);
+      return;
+    }
+
+    segment = ClampToCalendar(segment);
+    account.log.push_back({static_cast<uint32_t>(segment.left), static_cast<uint32_t>(segment.right), operation});
+    if (account.log.size() > SMALL_ACCOUNT_OPERATIONS) {
+      account.tree.emplace(pool_, DAY_COUNT);
+      for (const auto& logged : account.log) {
+        account.tree->AddBulkOperation({logged.left, logged.right}, logged.operation);
+      }
+      account.log = {};
+    }
   }
 
-  Date date_from = START_DATE;
-  Date date_to = START_DATE;
-  size_t spend = 0;
-};
+  size_t AccountCount() const {
+    return accounts_.size();
+  }
 
-struct PayTaxRequest : ModifyRequest {
-  PayTaxRequest() : ModifyRequest(Type::PAY_TAX) {}
-  void ParseFrom(string_view input) override {
-    date_from = Date::FromString(ReadToken(input));
-    date_to = Date::FromString(ReadToken(input));
-    percentage = ConvertToInt(input);
+  size_t TreeNodeCount() const {
+    return pool_.Size();
   }
 
-  void Process(BudgetManager& manager) const override {
-    manager.AddBulkOperation(
-        MakeDateSegment(date_from, date_to),
-        BulkTaxApplier{1.0 - (percentage / 100.0)}
-    );
+  // Accounts table, operation logs and the node pool, container overheads included
+  size_t MemoryUsage() const {
+    size_t bytes = sizeof(*this) + pool_.MemoryUsage() + accounts_.bucket_count() * sizeof(void*);
+    for (const auto& [account_id, account] : accounts_) {
+      bytes += sizeof(void*) + sizeof(account_id) + sizeof(account) + account.log.capacity() * sizeof(LoggedOperation);
+    }
+    return bytes;
   }
 
-  Date date_from = START_DATE;
-  Date date_to = START_DATE;
-  uint32_t percentage = TAX_PERCENTAGE;
+private:
+  using Tree = SparseSummingSegmentTree<double, BulkLinearUpdater>;
+
+  struct LoggedOperation {
+    uint32_t left;
+    uint32_t right;
+    BulkLinearUpdater operation;
+  };
+
+  struct Account {
+    vector<LoggedOperation> log;
+    optional<Tree> tree;
+  };
+
+  Tree::NodePool pool_;
+  unordered_map<AccountId, Account> accounts_;
+
+  // Between two consecutive operation bounds every day has the same income
+  // and spending, so the replay is done once per such piece; the segment is
+  // within the calendar, as the tree would clamp it
+  static double ComputeLoggedSum(const vector<LoggedOperation>& log, IndexSegment segment) {
+    vector<size_t> bounds{segment.left, segment.right};
+    for (const auto& logged : log) {
+      for (const size_t bound : {size_t{logged.left}, size_t{logged.right}}) {
+        if (segment.left < bound && bound < segment.right) {
+          bounds.push_back(bound);
+        }
+      }
+    }
+    sort(begin(bounds), end(bounds));
+    bounds.erase(unique(begin(bounds), end(bounds)), end(bounds));
+
+    double sum = 0;
+    for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+      const IndexSegment piece{bounds[i], bounds[i + 1]};
+      double income = 0;
+      double spent = 0;
+      for (const auto& logged : log) {
+        if (IndexSegment{logged.left, logged.right}.Contains(piece)) {
+          tie(income, spent) = logged.operation.Collapse(income, spent, {0, 1});
+        }
+      }
+      sum += (income - spent) * piece.length();
+    }
+    return sum;
+  }
 };
 
-RequestHolder Request::Create(Request::Type type) {
-  switch (type) {
-    case Request::Type::COMPUTE_INCOME:
-      return make_unique<ComputeIncomeRequest>();
-    case Request::Type::EARN:
-      return make_unique<EarnRequest>();
-    case Request::Type::SPEND:
-      return make_unique<SpendRequest>();
-    case Request::Type::PAY_TAX:
-      return make_unique<PayTaxRequest>();
-    default:
-      return nullptr;
+
+// Requests are plain values: an input becomes one contiguous vector of them,
+// and processing switches over the type instead of calling virtual methods
+struct Request {
+  enum class Type : uint8_t {
+    COMPUTE_INCOME,
+    EARN,
+    SPEND,
+    PAY_TAX
+  };
+
+  Type type = Type::COMPUTE_INCOME;
+  // Days of the request within the calendar, [day_from, day_to)
+  uint32_t day_from = 0;
+  uint32_t day_to = 0;
+  // Days between the dates as written; incomes and spendings are spread over
+  // all of them, including the ones past the calendar
+  uint32_t day_count = 0;
+  // Income, spending or tax percentage as written in the request
+  int32_t amount = 0;
+  AccountId account = DEFAULT_ACCOUNT;
+
+  IndexSegment GetSegment() const {
+    return {day_from, day_to};
   }
-}
+
+  double GetDailyAmount() const {
+    return GetSegment().empty() ? 0.0 : static_cast<size_t>(amount) * 1.0 / day_count;
+  }
+
+  double GetTaxFactor() const {
+    return 1.0 - (static_cast<uint32_t>(amount) / 100.0);
+  }
+};
+
+const unordered_map<string_view, Request::Type> STR_TO_REQUEST_TYPE = {
+    {"ComputeIncome", Request::Type::COMPUTE_INCOME},
+    {"Earn", Request::Type::EARN},
+    {"Spend", Request::Type::SPEND},
+    {"PayTax", Request::Type::PAY_TAX},
+};
 
 template <typename Number>
 Number ReadNumberOnLine(istream& stream) {
@@ -478,57 +1090,1467 @@ optional<Request::Type> ConvertRequestTypeFromString(string_view type_str) {
   }
 }
 
-RequestHolder ParseRequest(string_view request_str) {
+AccountId ConvertToAccountId(string_view str) {
+  size_t pos;
+  const AccountId result = stoull(string(str), &pos);
+  if (pos != str.length()) {
+    std::stringstream error;
+    error << "account id " << str << " contains " << (str.length() - pos) << " trailing chars";
+    throw invalid_argument(error.str());
+  }
+  return result;
+}
+
+// A request may start with the id of its account, "42 Earn 2000-01-02 2000-01-06 20"
+optional<Request> ParseRequest(string_view request_str) {
+  Request request;
+  if (!request_str.empty() && isdigit(static_cast<unsigned char>(request_str.front()))) {
+    request.account = ConvertToAccountId(ReadToken(request_str));
+  }
   const auto request_type = ConvertRequestTypeFromString(ReadToken(request_str));
   if (!request_type) {
-    return nullptr;
+    return nullopt;
+  }
+  request.type = *request_type;
+
+  const bool is_modification = request.type != Request::Type::COMPUTE_INCOME;
+  const Date date_from = Date::FromString(ReadToken(request_str));
+  const Date date_to = Date::FromString(is_modification ? ReadToken(request_str) : request_str);
+  if (is_modification) {
+    request.amount = ConvertToInt(request_str);
+  }
+
+  // Days past the calendar are dropped, and a period starting before it or
+  // ending before its start is empty, so the days always fit in 32 bits
+  const IndexSegment segment = MakeDateSegment(date_from, date_to);
+  const IndexSegment days = ClampToCalendar(segment);
+  request.day_from = static_cast<uint32_t>(days.left);
+  request.day_to = static_cast<uint32_t>(days.right);
+  if (!days.empty()) {
+    request.day_count = static_cast<uint32_t>(segment.length());
   }
-  RequestHolder request = Request::Create(*request_type);
-  if (request) {
-    request->ParseFrom(request_str);
-  };
   return request;
 }
 
-vector<RequestHolder> ReadRequests(istream& in_stream = cin) {
+// The input is read in blocks into one reused buffer, and requests are parsed
+// right from it without a string per line; the unfinished last line of a
+// block is moved to the front of the buffer and completed by the next read
+vector<Request> ReadRequests(istream& in_stream = cin) {
   const size_t request_count = ReadNumberOnLine<size_t>(in_stream);
 
-  vector<RequestHolder> requests;
+  vector<Request> requests;
   requests.reserve(request_count);
 
-  for (size_t i = 0; i < request_count; ++i) {
-    string request_str;
-    getline(in_stream, request_str);
-    if (auto request = ParseRequest(request_str)) {
-      requests.push_back(move(request));
+  size_t buffer_size = 1 << 20;
+  // Left uninitialized, every byte is read before it is parsed
+  unique_ptr<char[]> buffer(new char[buffer_size]);
+  size_t carried_size = 0;
+  size_t line_count = 0;
+  while (line_count < request_count) {
+    if (carried_size == buffer_size) {
+      // A line longer than the whole buffer
+      unique_ptr<char[]> larger_buffer(new char[2 * buffer_size]);
+      copy_n(buffer.get(), carried_size, larger_buffer.get());
+      buffer = move(larger_buffer);
+      buffer_size *= 2;
+    }
+    in_stream.read(buffer.get() + carried_size, buffer_size - carried_size);
+    const bool is_last_block = !in_stream;
+
+    string_view rest(buffer.get(), carried_size + in_stream.gcount());
+    for (; line_count < request_count && !rest.empty(); ++line_count) {
+      const size_t line_end = rest.find('\n');
+      if (line_end == rest.npos && !is_last_block) {
+        break;
+      }
+      const string_view line = rest.substr(0, line_end);
+      rest.remove_prefix(line_end == rest.npos ? rest.size() : line_end + 1);
+      if (const auto request = ParseRequest(line)) {
+        requests.push_back(*request);
+      }
+    }
+    if (is_last_block) {
+      break;
     }
+
+    carried_size = rest.size();
+    copy(rest.begin(), rest.end(), buffer.get());
   }
   return requests;
 }
 
-vector<double> ProcessRequests(const vector<RequestHolder>& requests) {
+// Offline processing of a request list known upfront, without the tree.
+// Earn and Spend only touch difference arrays; they are swept into per-day
+// values before the next PayTax or ComputeIncome. PayTax scales the per-day
+// income directly, and ComputeIncome reads prefix sums that are rebuilt
+// after every change.
+class BatchBudgetProcessor {
+public:
+  explicit BatchBudgetProcessor(size_t day_count)
+      : income_(day_count)
+      , spent_(day_count)
+      , income_delta_(day_count + 1)
+      , spent_delta_(day_count + 1)
+      , prefix_(day_count + 1)
+  {}
+
+  void Earn(IndexSegment segment, double daily_income) {
+    AddDelta(income_delta_, segment, daily_income);
+  }
+
+  void Spend(IndexSegment segment, double daily_spend) {
+    AddDelta(spent_delta_, segment, daily_spend);
+  }
+
+  void PayTax(IndexSegment segment, double factor) {
+    segment = Clamp(segment);
+    Sweep();
+    for (size_t day = segment.left; day < segment.right; ++day) {
+      income_[day] *= factor;
+    }
+    prefix_valid_ = false;
+  }
+
+  double ComputeIncome(IndexSegment segment) {
+    segment = Clamp(segment);
+    Sweep();
+    if (!prefix_valid_) {
+      for (size_t day = 0; day < income_.size(); ++day) {
+        prefix_[day + 1] = prefix_[day] + income_[day] - spent_[day];
+      }
+      prefix_valid_ = true;
+    }
+    return static_cast<double>(prefix_[segment.right] - prefix_[segment.left]);
+  }
+
+  // Days touched by the sweeps, prefix rebuilds and taxes of the requests
+  static size_t EstimateCost(const vector<Request>& requests, size_t day_count);
+
+private:
+  vector<double> income_;
+  vector<double> spent_;
+  vector<double> income_delta_;
+  vector<double> spent_delta_;
+  vector<long double> prefix_;
+  bool has_deltas_ = false;
+  bool prefix_valid_ = true;
+
+  // Days past the end are dropped, as the trees do
+  IndexSegment Clamp(IndexSegment segment) const {
+    const IndexSegment days = IntersectSegments(segment, {0, income_.size()});
+    return days.empty() ? IndexSegment{0, 0} : days;
+  }
+
+  void AddDelta(vector<double>& delta, IndexSegment segment, double value) {
+    segment = Clamp(segment);
+    delta[segment.left] += value;
+    delta[segment.right] -= value;
+    has_deltas_ = true;
+  }
+
+  void Sweep() {
+    if (!has_deltas_) {
+      return;
+    }
+    long double daily_income = 0;
+    long double daily_spend = 0;
+    for (size_t day = 0; day < income_.size(); ++day) {
+      daily_income += income_delta_[day];
+      daily_spend += spent_delta_[day];
+      income_[day] += static_cast<double>(daily_income);
+      spent_[day] += static_cast<double>(daily_spend);
+    }
+    fill(begin(income_delta_), end(income_delta_), 0.0);
+    fill(begin(spent_delta_), end(spent_delta_), 0.0);
+    has_deltas_ = false;
+    prefix_valid_ = false;
+  }
+};
+
+size_t BatchBudgetProcessor::EstimateCost(const vector<Request>& requests, size_t day_count) {
+  size_t cost = 0;
+  bool has_deltas = false;
+  bool prefix_valid = true;
+  for (const auto& request : requests) {
+    switch (request.type) {
+      case Request::Type::EARN:
+      case Request::Type::SPEND:
+        has_deltas = true;
+        break;
+      case Request::Type::PAY_TAX:
+        if (has_deltas) {
+          cost += day_count;
+          has_deltas = false;
+        }
+        cost += request.GetSegment().length();
+        prefix_valid = false;
+        break;
+      case Request::Type::COMPUTE_INCOME:
+        if (has_deltas) {
+          cost += day_count;
+          has_deltas = false;
+          prefix_valid = false;
+        }
+        if (!prefix_valid) {
+          cost += day_count;
+          prefix_valid = true;
+        }
+        break;
+    }
+  }
+  return cost;
+}
+
+// A tree request walks a few dozen nodes, which costs about as much as
+// sweeping this many days
+constexpr size_t ONLINE_REQUEST_COST_IN_DAYS = 200;
+
+bool ShouldProcessInBatch(const vector<Request>& requests) {
+  return BatchBudgetProcessor::EstimateCost(requests, DAY_COUNT) < requests.size() * ONLINE_REQUEST_COST_IN_DAYS;
+}
+
+vector<double> ProcessRequestsInBatch(const vector<Request>& requests) {
   vector<double> responses;
-  BudgetManager manager;
-  for (const auto& request_holder : requests) {
-    if (request_holder->type == Request::Type::COMPUTE_INCOME) {
-      const auto& request = static_cast<const ComputeIncomeRequest&>(*request_holder);
-      responses.push_back(request.Process(manager));
-    } else {
-      const auto& request = static_cast<const ModifyRequest&>(*request_holder);
-      request.Process(manager);
+  BatchBudgetProcessor processor(DAY_COUNT);
+  for (const auto& request : requests) {
+    switch (request.type) {
+      case Request::Type::COMPUTE_INCOME:
+        responses.push_back(processor.ComputeIncome(request.GetSegment()));
+        break;
+      case Request::Type::EARN:
+        processor.Earn(request.GetSegment(), request.GetDailyAmount());
+        break;
+      case Request::Type::SPEND:
+        processor.Spend(request.GetSegment(), request.GetDailyAmount());
+        break;
+      case Request::Type::PAY_TAX:
+        processor.PayTax(request.GetSegment(), request.GetTaxFactor());
+        break;
+    }
+  }
+  return responses;
+}
+
+vector<double> ProcessRequestsOnline(const vector<Request>& requests) {
+  vector<double> responses;
+  const bool has_taxes = any_of(begin(requests), end(requests), [](const Request& request) {
+    return request.type == Request::Type::PAY_TAX;
+  });
+  BudgetManager manager(has_taxes ? BudgetManager::Backend::SEGMENT_TREE : BudgetManager::Backend::FENWICK_TREES);
+  for (const auto& request : requests) {
+    switch (request.type) {
+      case Request::Type::COMPUTE_INCOME:
+        responses.push_back(manager.ComputeSum(request.GetSegment()));
+        break;
+      case Request::Type::EARN:
+        manager.AddBulkOperation(request.GetSegment(), BulkMoneyAdder{request.GetDailyAmount()});
+        break;
+      case Request::Type::SPEND:
+        manager.AddBulkOperation(request.GetSegment(), BulkMoneySpender{request.GetDailyAmount()});
+        break;
+      case Request::Type::PAY_TAX:
+        manager.AddBulkOperation(request.GetSegment(), BulkTaxApplier{request.GetTaxFactor()});
+        break;
+    }
+  }
+  return responses;
+}
+
+vector<double> ProcessRequestsByAccount(const vector<Request>& requests) {
+  vector<double> responses;
+  MultiAccountBudgetManager manager;
+  for (const auto& request : requests) {
+    switch (request.type) {
+      case Request::Type::COMPUTE_INCOME:
+        responses.push_back(manager.ComputeSum(request.account, request.GetSegment()));
+        break;
+      case Request::Type::EARN:
+        manager.AddBulkOperation(request.account, request.GetSegment(), BulkMoneyAdder{request.GetDailyAmount()});
+        break;
+      case Request::Type::SPEND:
+        manager.AddBulkOperation(request.account, request.GetSegment(), BulkMoneySpender{request.GetDailyAmount()});
+        break;
+      case Request::Type::PAY_TAX:
+        manager.AddBulkOperation(request.account, request.GetSegment(), BulkTaxApplier{request.GetTaxFactor()});
+        break;
     }
   }
   return responses;
 }
 
+vector<double> ProcessRequests(const vector<Request>& requests) {
+  const bool single_account = all_of(begin(requests), end(requests), [](const Request& request) {
+    return request.account == DEFAULT_ACCOUNT;
+  });
+  if (!single_account) {
+    return ProcessRequestsByAccount(requests);
+  }
+  return ShouldProcessInBatch(requests) ? ProcessRequestsInBatch(requests) : ProcessRequestsOnline(requests);
+}
+
+// Prints like stream << response << endl with the precision of the stream,
+// but formats everything into one buffer and flushes once
 void PrintResponses(const vector<double>& responses, ostream& stream = cout) {
+  static constexpr size_t MAX_RESPONSE_LENGTH = 64;
+  const int precision = static_cast<int>(stream.precision());
+  string output(responses.size() * MAX_RESPONSE_LENGTH, '\0');
+  char* position = output.data();
   for (const double response : responses) {
-    stream << response << endl;
+    position = to_chars(position, position + MAX_RESPONSE_LENGTH - 1, response, chars_format::general, precision).ptr;
+    *position++ = '\n';
   }
+  stream.write(output.data(), position - output.data());
+  stream.flush();
 }
 
 
-int main() {
+#ifdef BUDGET_MOBILE_TEST
+// The original tree with separately allocated nodes, kept as the reference
+// for the array layout
+template <typename Data, typename BulkOperation>
+class PointerSummingSegmentTree {
+public:
+  PointerSummingSegmentTree(size_t size) : root_(Build({0, size})) {}
+
+  Data ComputeSum(IndexSegment segment) const {
+    return this->TraverseWithQuery(root_, segment, ComputeSumVisitor{});
+  }
+
+  void AddBulkOperation(IndexSegment segment, const BulkOperation& operation) {
+    this->TraverseWithQuery(root_, segment, AddBulkOperationVisitor{operation});
+  }
+
+private:
+  struct Node;
+  using NodeHolder = unique_ptr<Node>;
+
+  struct Node {
+    NodeHolder left;
+    NodeHolder right;
+    IndexSegment segment;
+    Data data;
+    Data spent;
+    BulkOperation postponed_bulk_operation;
+  };
+
+  NodeHolder root_;
+
+  static NodeHolder Build(IndexSegment segment) {
+    if (segment.empty()) {
+      return nullptr;
+    } else if (segment.length() == 1) {
+      return make_unique<Node>(Node{
+        .left = nullptr,
+        .right = nullptr,
+        .segment = segment,
+      });
+    } else {
+      const size_t middle = segment.left + segment.length() / 2;
+      return make_unique<Node>(Node{
+        .left = Build({segment.left, middle}),
+        .right = Build({middle, segment.right}),
+        .segment = segment,
+      });
+    }
+  }
+
+  template <typename Visitor>
+  static typename Visitor::ResultType TraverseWithQuery(const NodeHolder& node, IndexSegment query_segment, Visitor visitor) {
+    if (!node || !AreSegmentsIntersected(node->segment, query_segment)) {
+      return visitor.ProcessEmpty(node);
+    } else {
+      PropagateBulkOperation(node);
+      if (query_segment.Contains(node->segment)) {
+        return visitor.ProcessFull(node);
+      } else {
+        if constexpr (is_void_v<typename Visitor::ResultType>) {
+          TraverseWithQuery(node->left, query_segment, visitor);
+          TraverseWithQuery(node->right, query_segment, visitor);
+          return visitor.ProcessPartial(node, query_segment);
+        } else {
+          return visitor.ProcessPartial(
+              node, query_segment,
+              TraverseWithQuery(node->left, query_segment, visitor),
+              TraverseWithQuery(node->right, query_segment, visitor)
+          );
+        }
+      }
+    }
+  }
+
+  class ComputeSumVisitor {
+  public:
+    using ResultType = Data;
+
+    Data ProcessEmpty(const NodeHolder&) const {
+      return {};
+    }
+
+    Data ProcessFull(const NodeHolder& node) const {
+      return node->data - node->spent;
+    }
+
+    Data ProcessPartial(const NodeHolder&, IndexSegment, const Data& left_result, const Data& right_result) const {
+      return left_result + right_result;
+    }
+  };
+
+  class AddBulkOperationVisitor {
+  public:
+    using ResultType = void;
+
+    explicit AddBulkOperationVisitor(const BulkOperation& operation)
+        : operation_(operation)
+    {}
+
+    void ProcessEmpty(const NodeHolder&) const {}
+
+    void ProcessFull(const NodeHolder& node) const {
+      node->postponed_bulk_operation.CombineWith(operation_);
+      tie(node->data, node->spent) = operation_.Collapse(node->data, node->spent, node->segment);
+    }
+
+    void ProcessPartial(const NodeHolder& node, IndexSegment) const {
+      node->data = (node->left ? node->left->data : Data()) + (node->right ? node->right->data : Data());
+      node->spent = (node->left ? node->left->spent : Data()) + (node->right ? node->right->spent : Data());
+    }
+
+  private:
+    const BulkOperation& operation_;
+  };
+
+  static void PropagateBulkOperation(const NodeHolder& node) {
+    for (auto* child_ptr : {node->left.get(), node->right.get()}) {
+      if (child_ptr) {
+        child_ptr->postponed_bulk_operation.CombineWith(node->postponed_bulk_operation);
+        std::tie(child_ptr->data, child_ptr->spent) = node->postponed_bulk_operation.Collapse(child_ptr->data, child_ptr->spent, child_ptr->segment);
+      }
+    }
+    node->postponed_bulk_operation = BulkOperation();
+  }
+};
+
+// The recursive tree over one implicit array, node 1 is the root and node i
+// has children 2i and 2i + 1, which the shared iterative tree replaced; kept
+// as the reference to benchmark against
+template <typename Data, typename BulkOperation>
+class RecursiveSummingSegmentTree {
+public:
+  RecursiveSummingSegmentTree(size_t size) : size_(size), nodes_(ComputeNodeCount(size)) {}
+
+  // Tree over the given values of every position
+  RecursiveSummingSegmentTree(const vector<Data>& data, const vector<Data>& spent)
+      : RecursiveSummingSegmentTree(data.size())
+  {
+    Build(ROOT, {0, size_}, data, spent);
+  }
+
+  Data ComputeSum(IndexSegment segment) const {
+    return this->TraverseWithQuery(ROOT, {0, size_}, segment, ComputeSumVisitor{nodes_});
+  }
+
+  void AddBulkOperation(IndexSegment segment, const BulkOperation& operation) {
+    this->TraverseWithQuery(ROOT, {0, size_}, segment, AddBulkOperationVisitor{nodes_, operation});
+  }
+
+private:
+  struct Node {
+    Data data;
+    Data spent;
+    BulkOperation postponed_bulk_operation;
+  };
+
+  static constexpr size_t ROOT = 1;
+
+  size_t size_;
+  // Queries push postponed operations down as well
+  mutable vector<Node> nodes_;
+
+  static size_t ComputeNodeCount(size_t size) {
+    size_t leaf_count = 1;
+    while (leaf_count < size) {
+      leaf_count *= 2;
+    }
+    return 2 * leaf_count;
+  }
+
+  static size_t LeftChild(size_t node) {
+    return 2 * node;
+  }
+
+  static size_t RightChild(size_t node) {
+    return 2 * node + 1;
+  }
+
+  static size_t Middle(IndexSegment segment) {
+    return segment.left + segment.length() / 2;
+  }
+
+  void Build(size_t node, IndexSegment segment, const vector<Data>& data, const vector<Data>& spent) {
+    if (segment.empty()) {
+      return;
+    } else if (segment.length() == 1) {
+      nodes_[node].data = data[segment.left];
+      nodes_[node].spent = spent[segment.left];
+      return;
+    }
+    const size_t middle = Middle(segment);
+    Build(LeftChild(node), {segment.left, middle}, data, spent);
+    Build(RightChild(node), {middle, segment.right}, data, spent);
+    nodes_[node].data = nodes_[LeftChild(node)].data + nodes_[RightChild(node)].data;
+    nodes_[node].spent = nodes_[LeftChild(node)].spent + nodes_[RightChild(node)].spent;
+  }
+
+  template <typename Visitor>
+  typename Visitor::ResultType TraverseWithQuery(size_t node, IndexSegment node_segment, IndexSegment query_segment, Visitor visitor) const {
+    if (node_segment.empty() || !AreSegmentsIntersected(node_segment, query_segment)) {
+      return visitor.ProcessEmpty(node);
+    } else {
+      PropagateBulkOperation(node, node_segment);
+      if (query_segment.Contains(node_segment)) {
+        return visitor.ProcessFull(node, node_segment);
+      } else {
+        const size_t middle = Middle(node_segment);
+        if constexpr (is_void_v<typename Visitor::ResultType>) {
+          TraverseWithQuery(LeftChild(node), {node_segment.left, middle}, query_segment, visitor);
+          TraverseWithQuery(RightChild(node), {middle, node_segment.right}, query_segment, visitor);
+          return visitor.ProcessPartial(node, query_segment);
+        } else {
+          return visitor.ProcessPartial(
+              node, query_segment,
+              TraverseWithQuery(LeftChild(node), {node_segment.left, middle}, query_segment, visitor),
+              TraverseWithQuery(RightChild(node), {middle, node_segment.right}, query_segment, visitor)
+          );
+        }
+      }
+    }
+  }
+
+  class ComputeSumVisitor {
+  public:
+    using ResultType = Data;
+
+    explicit ComputeSumVisitor(const vector<Node>& nodes)
+        : nodes_(nodes)
+    {}
+
+    Data ProcessEmpty(size_t) const {
+      return {};
+    }
+
+    Data ProcessFull(size_t node, IndexSegment) const {
+      return nodes_[node].data - nodes_[node].spent;
+    }
+
+    Data ProcessPartial(size_t, IndexSegment, const Data& left_result, const Data& right_result) const {
+      return left_result + right_result;
+    }
+
+  private:
+    const vector<Node>& nodes_;
+  };
+
+  class AddBulkOperationVisitor {
+  public:
+    using ResultType = void;
+
+    AddBulkOperationVisitor(vector<Node>& nodes, const BulkOperation& operation)
+        : nodes_(nodes)
+        , operation_(operation)
+    {}
+
+    void ProcessEmpty(size_t) const {}
+
+    void ProcessFull(size_t node, IndexSegment segment) const {
+      auto& full_node = nodes_[node];
+      full_node.postponed_bulk_operation.CombineWith(operation_);
+      tie(full_node.data, full_node.spent) = operation_.Collapse(full_node.data, full_node.spent, segment);
+    }
+
+    void ProcessPartial(size_t node, IndexSegment) const {
+      const auto& left = nodes_[LeftChild(node)];
+      const auto& right = nodes_[RightChild(node)];
+      nodes_[node].data = left.data + right.data;
+      nodes_[node].spent = left.spent + right.spent;
+    }
+
+  private:
+    vector<Node>& nodes_;
+    const BulkOperation& operation_;
+  };
+
+  void PropagateBulkOperation(size_t node, IndexSegment segment) const {
+    if (segment.length() > 1) {
+      const size_t middle = Middle(segment);
+      const pair<size_t, IndexSegment> children[] = {
+        {LeftChild(node), {segment.left, middle}},
+        {RightChild(node), {middle, segment.right}},
+      };
+      for (const auto& [child, child_segment] : children) {
+        auto& child_node = nodes_[child];
+        child_node.postponed_bulk_operation.CombineWith(nodes_[node].postponed_bulk_operation);
+        std::tie(child_node.data, child_node.spent) =
+            nodes_[node].postponed_bulk_operation.Collapse(child_node.data, child_node.spent, child_segment);
+      }
+    }
+    nodes_[node].postponed_bulk_operation = BulkOperation();
+  }
+};
+
+struct TestOperation {
+  enum class Kind {
+    COMPUTE_SUM,
+    ADD,
+    SPEND,
+    TAX,
+  };
+
+  Kind kind;
+  IndexSegment segment;
+  double value;
+};
+
+vector<TestOperation> MakeRandomOperations(size_t count, size_t size, unsigned int seed) {
+  mt19937 generator{seed};
+  uniform_int_distribution<size_t> position{0, size - 1};
+  uniform_int_distribution<size_t> length{1, 400};
+  uniform_int_distribution<int> kind{0, 9};
+  uniform_real_distribution<double> amount{1, 1e6};
+
+  vector<TestOperation> operations;
+  operations.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const size_t left = position(generator);
+    const IndexSegment segment{left, min(size, left + length(generator))};
+    const int k = kind(generator);
+    if (k < 4) {
+      operations.push_back({TestOperation::Kind::COMPUTE_SUM, segment, 0});
+    } else if (k < 7) {
+      operations.push_back({TestOperation::Kind::ADD, segment, amount(generator)});
+    } else if (k < 9) {
+      operations.push_back({TestOperation::Kind::SPEND, segment, amount(generator)});
+    } else {
+      operations.push_back({TestOperation::Kind::TAX, segment, 1.0 - TAX_PERCENTAGE / 100.0});
+    }
+  }
+  return operations;
+}
+
+template <typename Tree>
+vector<double> RunOperations(Tree& tree, const vector<TestOperation>& operations) {
+  vector<double> sums;
+  for (const auto& operation : operations) {
+    switch (operation.kind) {
+      case TestOperation::Kind::COMPUTE_SUM:
+        sums.push_back(static_cast<double>(tree.ComputeSum(operation.segment)));
+        break;
+      case TestOperation::Kind::ADD:
+        tree.AddBulkOperation(operation.segment, BulkMoneyAdder{operation.value / operation.segment.length()});
+        break;
+      case TestOperation::Kind::SPEND:
+        tree.AddBulkOperation(operation.segment, BulkMoneySpender{operation.value / operation.segment.length()});
+        break;
+      case TestOperation::Kind::TAX:
+        tree.AddBulkOperation(operation.segment, BulkTaxApplier{operation.value});
+        break;
+    }
+  }
+  return sums;
+}
+
+void AssertSameResponses(const vector<double>& lhs, const vector<double>& rhs) {
+  ASSERT_EQUAL(lhs.size(), rhs.size());
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    // Both paths round differently, the totals reach 10^12
+    if (abs(lhs[i] - rhs[i]) > 1e-3 + 1e-12 * abs(rhs[i])) {
+      ostringstream error;
+      error << "response " << i << ": " << lhs[i] << " != " << rhs[i];
+      Assert(false, error.str());
+    }
+  }
+}
+
+void TestArrayTreeMatchesPointerTree() {
+  for (size_t size : {1, 2, 3, 17, 1000, 36525}) {
+    const auto operations = MakeRandomOperations(5000, size, static_cast<unsigned int>(size));
+    RecursiveSummingSegmentTree<double, BulkLinearUpdater> recursive_tree(size);
+    PointerSummingSegmentTree<double, BulkLinearUpdater> pointer_tree(size);
+    const auto expected = RunOperations(pointer_tree, operations);
+    ASSERT_EQUAL(RunOperations(recursive_tree, operations), expected);
+
+    // Leaves are padded to a power of two, so sums are added in another order
+    SummingSegmentTree<double, BulkLinearUpdater> array_tree(size);
+    AssertSameResponses(RunOperations(array_tree, operations), expected);
+  }
+}
+
+void BenchmarkSegmentTrees() {
+  const auto operations = MakeRandomOperations(1'000'000, DAY_COUNT, 42);
+  double pointer_checksum = 0;
+  double recursive_checksum = 0;
+  double iterative_checksum = 0;
+  {
+    LOG_DURATION("Pointer tree, 1M mixed requests");
+    PointerSummingSegmentTree<double, BulkLinearUpdater> tree(DAY_COUNT);
+    const auto sums = RunOperations(tree, operations);
+    pointer_checksum = accumulate(begin(sums), end(sums), 0.0);
+  }
+  {
+    LOG_DURATION("Recursive array tree, 1M mixed requests");
+    RecursiveSummingSegmentTree<double, BulkLinearUpdater> tree(DAY_COUNT);
+    const auto sums = RunOperations(tree, operations);
+    recursive_checksum = accumulate(begin(sums), end(sums), 0.0);
+  }
+  {
+    LOG_DURATION("Iterative array tree, 1M mixed requests");
+    SummingSegmentTree<double, BulkLinearUpdater> tree(DAY_COUNT);
+    const auto sums = RunOperations(tree, operations);
+    iterative_checksum = accumulate(begin(sums), end(sums), 0.0);
+  }
+  cerr << "Segment tree benchmark checksum differences: "
+       << pointer_checksum - recursive_checksum << ", "
+       << pointer_checksum - iterative_checksum << endl;
+}
+
+string MakeRandomDate(mt19937& generator) {
+  uniform_int_distribution<int> year{2000, 2099};
+  uniform_int_distribution<int> month{1, 12};
+  uniform_int_distribution<int> day{1, 28};
+  ostringstream date;
+  date << year(generator) << '-' << setw(2) << setfill('0') << month(generator)
+       << '-' << setw(2) << setfill('0') << day(generator);
+  return date.str();
+}
+
+// Blocks of modifications followed by blocks of queries; tax_share and
+// query_share are per mille of the requests
+vector<Request> MakeRandomRequests(size_t count, size_t block_size, int tax_share, int query_share, unsigned int seed) {
+  mt19937 generator{seed};
+  uniform_int_distribution<int> share{0, 999};
+  uniform_int_distribution<int> amount{1, 1'000'000};
+  vector<Request> requests;
+  requests.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    string from = MakeRandomDate(generator);
+    string to = MakeRandomDate(generator);
+    if (to < from) {
+      swap(from, to);
+    }
+    const bool query_block = (i / block_size) % 2 == 1;
+    const int kind = share(generator);
+    string request;
+    if (query_block || kind < query_share) {
+      request = "ComputeIncome " + from + " " + to;
+    } else if (kind < query_share + tax_share) {
+      request = "PayTax " + from + " " + to + " " + to_string(share(generator) % 100);
+    } else if (kind % 2 == 0) {
+      request = "Earn " + from + " " + to + " " + to_string(amount(generator));
+    } else {
+      request = "Spend " + from + " " + to + " " + to_string(amount(generator));
+    }
+    requests.push_back(*ParseRequest(request));
+  }
+  return requests;
+}
+
+void TestBatchMatchesOnline() {
+  const tuple<size_t, size_t, int, int> mixes[] = {
+    {2000, 1, 0, 400},      // interleaved, no taxes
+    {2000, 1, 100, 400},    // interleaved with taxes
+    {5000, 500, 0, 0},      // nightly runs of modifications and queries
+    {5000, 500, 50, 0},
+    {3000, 3000, 0, 0},     // modifications only
+  };
+  unsigned int seed = 0;
+  for (const auto& [count, block_size, tax_share, query_share] : mixes) {
+    const auto requests = MakeRandomRequests(count, block_size, tax_share, query_share, ++seed);
+    AssertSameResponses(ProcessRequestsInBatch(requests), ProcessRequestsOnline(requests));
+    AssertSameResponses(ProcessRequests(requests), ProcessRequestsOnline(requests));
+  }
+
+  // Requests ending on END_DATE reach one day past the calendar
+  vector<Request> end_date_requests;
+  for (int i = 0; i < 2000; ++i) {
+    end_date_requests.push_back(*ParseRequest("Earn 2099-12-02 2100-01-01 20"));
+  }
+  end_date_requests.push_back(*ParseRequest("PayTax 2099-12-20 2100-01-01 13"));
+  end_date_requests.push_back(*ParseRequest("ComputeIncome 2099-12-01 2100-01-01"));
+  end_date_requests.push_back(*ParseRequest("ComputeIncome 2100-01-01 2100-01-01"));
+  AssertSameResponses(ProcessRequestsInBatch(end_date_requests), ProcessRequestsOnline(end_date_requests));
+
+  // The processor clamps segments itself, like the tree
+  BatchBudgetProcessor processor(DAY_COUNT);
+  BudgetManager manager;
+  const IndexSegment past_end{DAY_COUNT - 30, DAY_COUNT + 1};
+  for (int i = 0; i < 2000; ++i) {
+    processor.Earn(past_end, 1);
+    manager.AddBulkOperation(past_end, BulkMoneyAdder{1});
+  }
+  processor.PayTax({DAY_COUNT - 10, DAY_COUNT + 10}, 0.87);
+  manager.AddBulkOperation({DAY_COUNT - 10, DAY_COUNT + 10}, BulkTaxApplier{0.87});
+  for (const IndexSegment segment : {past_end, IndexSegment{0, DAY_COUNT + 1}, IndexSegment{DAY_COUNT, DAY_COUNT + 5}}) {
+    AssertSameResponses({processor.ComputeIncome(segment)}, {manager.ComputeSum(segment)});
+  }
+}
+
+void TestBatchSelection() {
+  ASSERT(ShouldProcessInBatch(MakeRandomRequests(100'000, 20'000, 0, 0, 1)));
+  ASSERT(!ShouldProcessInBatch(MakeRandomRequests(100'000, 1, 0, 400, 2)));
+  ASSERT(!ShouldProcessInBatch(MakeRandomRequests(100'000, 20'000, 200, 0, 3)));
+}
+
+void BenchmarkBatchProcessing() {
+  // The batch pass sweeps the days again for every run of queries, so the
+  // interleaved mix it is not selected for stays small
+  const tuple<string, size_t, size_t, int, int> mixes[] = {
+    {"nightly, 10 runs", 1'000'000, 50'000, 0, 0},
+    {"nightly with taxes", 1'000'000, 50'000, 2, 0},
+    {"interleaved", 5'000, 1, 0, 400},
+  };
+  for (const auto& [name, request_count, block_size, tax_share, query_share] : mixes) {
+    const auto requests = MakeRandomRequests(request_count, block_size, tax_share, query_share, 7);
+    const string label = to_string(request_count) + " requests, " + name;
+    cerr << name << ": batch cost " << BatchBudgetProcessor::EstimateCost(requests, DAY_COUNT) << " days, "
+         << (ShouldProcessInBatch(requests) ? "batch" : "online") << " selected" << endl;
+    double checksum = 0;
+    {
+      LOG_DURATION("Online, " + label);
+      const auto responses = ProcessRequestsOnline(requests);
+      checksum += accumulate(begin(responses), end(responses), 0.0);
+    }
+    {
+      LOG_DURATION("Batch, " + label);
+      const auto responses = ProcessRequestsInBatch(requests);
+      checksum -= accumulate(begin(responses), end(responses), 0.0);
+    }
+    cerr << "Checksum difference: " << checksum << endl;
+  }
+}
+
+vector<TestOperation> WithoutTaxes(vector<TestOperation> operations) {
+  operations.erase(remove_if(begin(operations), end(operations), [](const TestOperation& operation) {
+    return operation.kind == TestOperation::Kind::TAX;
+  }), end(operations));
+  return operations;
+}
+
+void TestRangeFenwickTree() {
+  for (size_t size : {1, 2, 3, 17, 1000}) {
+    mt19937 generator{static_cast<unsigned int>(size)};
+    uniform_int_distribution<size_t> position{0, size};
+    uniform_int_distribution<int> value{-1000, 1000};
+    RangeFenwickTree<int64_t> tree(size);
+    vector<int64_t> values(size);
+    for (size_t i = 0; i < 1000; ++i) {
+      size_t left = position(generator);
+      size_t right = position(generator);
+      if (right < left) {
+        swap(left, right);
+      }
+      if (i % 2 == 0) {
+        const int delta = value(generator);
+        tree.Add({left, right}, delta);
+        for (size_t j = left; j < right; ++j) {
+          values[j] += delta;
+        }
+      } else {
+        ASSERT_EQUAL(tree.ComputeSum({left, right}), accumulate(begin(values) + left, begin(values) + right, int64_t{0}));
+      }
+    }
+    for (size_t j = 0; j < size; ++j) {
+      ASSERT_EQUAL(tree.GetValue(j), values[j]);
+    }
+  }
+}
+
+void TestBudgetBackends() {
+  const auto operations = MakeRandomOperations(20000, DAY_COUNT, 21);
+  const auto operations_without_taxes = WithoutTaxes(operations);
+  {
+    BudgetManager fenwick_budget(BudgetManager::Backend::FENWICK_TREES);
+    BudgetManager tree_budget(BudgetManager::Backend::SEGMENT_TREE);
+    AssertSameResponses(RunOperations(fenwick_budget, operations_without_taxes),
+                        RunOperations(tree_budget, operations_without_taxes));
+    ASSERT(fenwick_budget.GetBackend() == BudgetManager::Backend::FENWICK_TREES);
+  }
+  {
+    // The first tax moves the budget to the segment tree
+    BudgetManager fenwick_budget(BudgetManager::Backend::FENWICK_TREES);
+    BudgetManager tree_budget(BudgetManager::Backend::SEGMENT_TREE);
+    AssertSameResponses(RunOperations(fenwick_budget, operations), RunOperations(tree_budget, operations));
+    ASSERT(fenwick_budget.GetBackend() == BudgetManager::Backend::SEGMENT_TREE);
+  }
+  {
+    // Segments touching the first and the last day or reaching past them
+    auto edge_operations = WithoutTaxes(MakeRandomOperations(2000, DAY_COUNT + 10, 22));
+    for (const IndexSegment segment : {IndexSegment{0, 1}, IndexSegment{DAY_COUNT - 1, DAY_COUNT},
+                                       IndexSegment{DAY_COUNT - 1, DAY_COUNT + 1}, IndexSegment{DAY_COUNT, DAY_COUNT + 3}}) {
+      edge_operations.push_back({TestOperation::Kind::ADD, segment, 100});
+      edge_operations.push_back({TestOperation::Kind::COMPUTE_SUM, segment, 0});
+      edge_operations.push_back({TestOperation::Kind::COMPUTE_SUM, {0, DAY_COUNT + 1}, 0});
+    }
+    BudgetManager fenwick_budget(BudgetManager::Backend::FENWICK_TREES);
+    BudgetManager tree_budget(BudgetManager::Backend::SEGMENT_TREE);
+    AssertSameResponses(RunOperations(fenwick_budget, edge_operations), RunOperations(tree_budget, edge_operations));
+    ASSERT(fenwick_budget.GetBackend() == BudgetManager::Backend::FENWICK_TREES);
+  }
+}
+
+void BenchmarkBudgetBackends() {
+  const auto operations = WithoutTaxes(MakeRandomOperations(1'000'000, DAY_COUNT, 42));
+  double checksum = 0;
+  for (const auto backend : {BudgetManager::Backend::SEGMENT_TREE, BudgetManager::Backend::FENWICK_TREES}) {
+    const bool is_tree = backend == BudgetManager::Backend::SEGMENT_TREE;
+    BudgetManager budget(backend);
+    LOG_DURATION(string(is_tree ? "Segment tree" : "Fenwick trees") + ", 1M requests without taxes");
+    const auto sums = RunOperations(budget, operations);
+    checksum += (is_tree ? 1 : -1) * accumulate(begin(sums), end(sums), 0.0);
+  }
+  cerr << "Backend benchmark checksum difference: " << checksum << endl;
+}
+
+void TestFixedMoney() {
+  const auto to_string = [](FixedMoney money) {
+    ostringstream out;
+    out << money;
+    return out.str();
+  };
+  ASSERT_EQUAL(to_string(FixedMoney{}), "0.000000");
+  ASSERT_EQUAL(to_string(FixedMoney::FromUnits(-1)), "-0.000001");
+  ASSERT_EQUAL(to_string(FixedMoney::FromDouble(20.0 / 3)), "6.666667");
+  ASSERT_EQUAL(to_string(FixedMoney::FromUnits(numeric_limits<int64_t>::min())), "-9223372036854.775808");
+
+  const auto tax = FixedFactor::FromDouble(1.0 - TAX_PERCENTAGE / 100.0);
+  ASSERT_EQUAL(tax.Apply(FixedMoney::FromDouble(100)).GetUnits(), 87'000'000);
+  ASSERT_EQUAL(tax.Apply(FixedMoney::FromUnits(1)).GetUnits(), 1);
+  ASSERT_EQUAL(tax.Apply(FixedMoney::FromUnits(-3)).GetUnits(), -3);
+  ASSERT_EQUAL(tax.Apply(FixedMoney::FromUnits(5'000'000'000'000'000'000)).GetUnits(), 4'350'000'000'000'000'000);
+}
+
+void TestFixedTreeIsExact() {
+  // Without taxes every sum is the exact sum of the rounded daily amounts
+  for (size_t size : {1, 17, 36525}) {
+    const auto operations = WithoutTaxes(MakeRandomOperations(5000, size, static_cast<unsigned int>(size)));
+    SummingSegmentTree<FixedMoney, FixedLinearUpdater> tree(size);
+    vector<FixedMoney> days(size);
+    for (const auto& operation : operations) {
+      const IndexSegment segment = operation.segment;
+      const auto daily = FixedMoney::FromDouble(operation.value / segment.length());
+      switch (operation.kind) {
+        case TestOperation::Kind::COMPUTE_SUM:
+          ASSERT_EQUAL(tree.ComputeSum(segment).GetUnits(),
+                       accumulate(begin(days) + segment.left, begin(days) + segment.right, FixedMoney{}).GetUnits());
+          break;
+        case TestOperation::Kind::ADD:
+          tree.AddBulkOperation(segment, BulkMoneyAdder{operation.value / segment.length()});
+          for_each(begin(days) + segment.left, begin(days) + segment.right, [daily](FixedMoney& day) { day += daily; });
+          break;
+        case TestOperation::Kind::SPEND:
+          tree.AddBulkOperation(segment, BulkMoneySpender{operation.value / segment.length()});
+          for_each(begin(days) + segment.left, begin(days) + segment.right, [daily](FixedMoney& day) { day -= daily; });
+          break;
+        case TestOperation::Kind::TAX:
+          break;
+      }
+    }
+  }
+}
+
+void TestFixedTreeMatchesDoubleTree() {
+  const auto operations = MakeRandomOperations(20000, DAY_COUNT, 8);
+  SummingSegmentTree<FixedMoney, FixedLinearUpdater> fixed_tree(DAY_COUNT);
+  SummingSegmentTree<double, BulkLinearUpdater> double_tree(DAY_COUNT);
+  const auto fixed_sums = RunOperations(fixed_tree, operations);
+  const auto double_sums = RunOperations(double_tree, operations);
+
+  // Every daily amount is rounded by at most half a millionth
+  double max_error = 0;
+  size_t sum_index = 0;
+  for (const auto& operation : operations) {
+    if (operation.kind == TestOperation::Kind::COMPUTE_SUM) {
+      const double error = abs(fixed_sums[sum_index] - double_sums[sum_index]);
+      ASSERT(error <= max_error + 1e-3);
+      ++sum_index;
+    } else {
+      max_error += 0.5e-6 * operation.segment.length();
+    }
+  }
+}
+
+void BenchmarkFixedMoney() {
+  const auto operations = MakeRandomOperations(1'000'000, DAY_COUNT, 42);
+  double checksum = 0;
+  {
+    SummingSegmentTree<double, BulkLinearUpdater> tree(DAY_COUNT);
+    LOG_DURATION("double tree, 1M mixed requests");
+    const auto sums = RunOperations(tree, operations);
+    checksum += accumulate(begin(sums), end(sums), 0.0);
+  }
+  {
+    SummingSegmentTree<FixedMoney, FixedLinearUpdater> tree(DAY_COUNT);
+    LOG_DURATION("FixedMoney tree, 1M mixed requests");
+    const auto sums = RunOperations(tree, operations);
+    checksum -= accumulate(begin(sums), end(sums), 0.0);
+  }
+  cerr << "Fixed money benchmark checksum difference: " << checksum << endl;
+}
+
+void TestSparseTreeMatchesArrayTree() {
+  for (size_t size : {1, 2, 3, 17, 1000, 36525}) {
+    const auto operations = MakeRandomOperations(5000, size, static_cast<unsigned int>(size));
+    SummingSegmentTree<double, BulkLinearUpdater> array_tree(size);
+    SparseSummingSegmentTree<double, BulkLinearUpdater>::NodePool pool;
+    SparseSummingSegmentTree<double, BulkLinearUpdater> sparse_tree(pool, size);
+    AssertSameResponses(RunOperations(sparse_tree, operations), RunOperations(array_tree, operations));
+  }
+}
+
+void TestPersistentTreeMatchesArrayTree() {
+  for (size_t size : {1, 2, 3, 17, 1000, 36525}) {
+    const auto operations = MakeRandomOperations(5000, size, static_cast<unsigned int>(size));
+    SummingSegmentTree<double, BulkLinearUpdater> array_tree(size);
+    PersistentSummingSegmentTree<double, BulkLinearUpdater> persistent_tree(size);
+    AssertSameResponses(RunOperations(persistent_tree, operations), RunOperations(array_tree, operations));
+  }
+}
+
+void TestSnapshotsKeepTheirVersion() {
+  const auto operations = MakeRandomOperations(3000, DAY_COUNT, 5);
+  PublishingBudgetManager manager;
+  SummingSegmentTree<double, BulkLinearUpdater> tree(DAY_COUNT);
+  vector<PublishingBudgetManager::Tree::Snapshot> snapshots;
+  vector<vector<double>> expected;
+  for (const auto& operation : operations) {
+    if (operation.kind == TestOperation::Kind::COMPUTE_SUM) {
+      continue;
+    }
+    const vector<TestOperation> update{operation};
+    RunOperations(tree, update);
+    RunOperations(manager, update);
+    if (snapshots.size() < 10 && operation.segment.left % 100 == 0) {
+      manager.Publish();
+      snapshots.push_back(manager.GetSnapshot());
+      expected.emplace_back();
+      for (const auto& query : operations) {
+        expected.back().push_back(tree.ComputeSum(query.segment));
+      }
+    }
+  }
+
+  ASSERT(!snapshots.empty());
+  for (size_t i = 0; i < snapshots.size(); ++i) {
+    vector<double> sums;
+    for (const auto& query : operations) {
+      sums.push_back(snapshots[i].ComputeSum(query.segment));
+    }
+    AssertSameResponses(sums, expected[i]);
+  }
+}
+
+// Previous implementation of the day difference, the reference for the calendar arithmetic
+int ComputeDaysDiffWithMktime(int year_to, int month_to, int day_to, int year_from, int month_from, int day_from) {
+  const auto as_timestamp = [](int year, int month, int day) {
+    std::tm t{};
+    t.tm_mday = day;
+    t.tm_mon = month - 1;
+    t.tm_year = year - 1900;
+    t.tm_isdst = 0;
+    return mktime(&t);
+  };
+  static constexpr int SECONDS_IN_DAY = 60 * 60 * 24;
+  return (as_timestamp(year_to, month_to, day_to) - as_timestamp(year_from, month_from, day_from)) / SECONDS_IN_DAY;
+}
+
+string FormatDate(int year, int month, int day) {
+  ostringstream out;
+  out << setfill('0') << setw(4) << year << '-' << setw(2) << month << '-' << setw(2) << day;
+  return out.str();
+}
+
+void TestDayIndexMatchesMktime() {
+  // Nonexistent days like 2001-02-30 are accepted and roll over
+  for (int year = 2000; year < 2100; ++year) {
+    for (int month = 1; month <= 12; ++month) {
+      for (int day = 1; day <= 31; ++day) {
+        const int expected = ComputeDaysDiffWithMktime(year, month, day, 2000, 1, 1);
+        ASSERT_EQUAL(static_cast<int>(ComputeDayIndex(Date::FromString(FormatDate(year, month, day)))), expected);
+      }
+    }
+  }
+  ASSERT_EQUAL(DAY_COUNT, 36525u);
+}
+
+void TestDateParsing() {
+  ASSERT_EQUAL(ComputeDayIndex(Date::FromString("2000-1-2")), 1u);
+  ASSERT_EQUAL(ComputeDayIndex(Date::FromString("2000-01-02")), 1u);
+  ASSERT_EQUAL(ComputeDayIndex(Date::FromString("+2000-01-02")), 1u);
+  ASSERT_THROWS([] { Date::FromString("2000-13-01"); });
+  ASSERT_THROWS([] { Date::FromString("2000-00-01"); });
+  ASSERT_THROWS([] { Date::FromString("2000-01-32"); });
+  ASSERT_THROWS([] { Date::FromString("2000-01-00"); });
+  ASSERT_THROWS([] { Date::FromString("2000-0a-01"); });
+  ASSERT_THROWS([] { Date::FromString("20000101"); });
+}
+
+void BenchmarkDateParsing() {
+  mt19937 generator{17};
+  vector<string> dates(1'000'000);
+  for (auto& date : dates) {
+    date = MakeRandomDate(generator);
+  }
+
+  size_t checksum = 0;
+  {
+    LOG_DURATION("1M dates, FromString and ComputeDayIndex");
+    for (const auto& date : dates) {
+      checksum += ComputeDayIndex(Date::FromString(date));
+    }
+  }
+  {
+    LOG_DURATION("1M dates, stoi and mktime");
+    for (const auto& date : dates) {
+      checksum -= ComputeDaysDiffWithMktime(stoi(date.substr(0, 4)), stoi(date.substr(5, 2)), stoi(date.substr(8, 2)), 2000, 1, 1);
+    }
+  }
+  cerr << "Date parsing checksum difference: " << checksum << endl;
+}
+
+string MakeRandomInput(size_t count, unsigned int seed) {
+  mt19937 generator{seed};
+  uniform_int_distribution<int> kind{0, 9};
+  uniform_int_distribution<int> amount{1, 1'000'000};
+  ostringstream input;
+  input << count << '\n';
+  for (size_t i = 0; i < count; ++i) {
+    string from = MakeRandomDate(generator);
+    string to = MakeRandomDate(generator);
+    if (to < from) {
+      swap(from, to);
+    }
+    const int k = kind(generator);
+    if (k < 7) {
+      input << "ComputeIncome " << from << ' ' << to << '\n';
+    } else if (k == 7) {
+      input << "Earn " << from << ' ' << to << ' ' << amount(generator) << '\n';
+    } else if (k == 8) {
+      input << (i % 1000) << " Spend " << from << ' ' << to << ' ' << amount(generator) << '\n';
+    } else {
+      input << "PayTax " << from << ' ' << to << ' ' << amount(generator) % 100 << '\n';
+    }
+  }
+  return input.str();
+}
+
+bool AreSameRequests(const Request& lhs, const Request& rhs) {
+  return tie(lhs.type, lhs.day_from, lhs.day_to, lhs.day_count, lhs.amount, lhs.account)
+      == tie(rhs.type, rhs.day_from, rhs.day_to, rhs.day_count, rhs.amount, rhs.account);
+}
+
+void TestReadRequests() {
+  {
+    // Several read blocks, so lines are split between them
+    const string input = MakeRandomInput(100'000, 3);
+    ASSERT(input.size() > 3 << 20);
+    istringstream in_stream(input);
+    const auto requests = ReadRequests(in_stream);
+
+    istringstream lines(input);
+    ReadNumberOnLine<size_t>(lines);
+    ASSERT_EQUAL(requests.size(), 100'000u);
+    for (const auto& request : requests) {
+      string line;
+      getline(lines, line);
+      ASSERT(AreSameRequests(request, *ParseRequest(line)));
+    }
+  }
+  {
+    // Unknown requests are skipped, the last line may have no line break
+    istringstream in_stream("3\nEarn 2000-01-02 2000-01-06 20\nRefund 2000-01-01 2000-01-02 1\nComputeIncome 2000-01-01 2001-01-01");
+    const auto requests = ReadRequests(in_stream);
+    ASSERT_EQUAL(requests.size(), 2u);
+    ASSERT(requests[0].type == Request::Type::EARN);
+    ASSERT_EQUAL(requests[0].day_from, 1u);
+    ASSERT_EQUAL(requests[0].day_to, 6u);
+    ASSERT_EQUAL(requests[0].amount, 20);
+    ASSERT(requests[1].type == Request::Type::COMPUTE_INCOME);
+    ASSERT_EQUAL(requests[1].day_to, 367u);
+  }
+  {
+    // A line longer than the read buffer
+    istringstream in_stream("2\n" + string(3 << 20, '0') + "42 Earn 2000-01-02 2000-01-06 20\nComputeIncome 2000-01-01 2001-01-01\n");
+    const auto requests = ReadRequests(in_stream);
+    ASSERT_EQUAL(requests.size(), 2u);
+    ASSERT_EQUAL(requests[0].account, 42u);
+    ASSERT_EQUAL(requests[0].amount, 20);
+    ASSERT(requests[1].type == Request::Type::COMPUTE_INCOME);
+  }
+}
+
+void TestRequestsOutsideCalendar() {
+  // Responses of the original implementation
+  const pair<string, vector<double>> cases[] = {
+    {"2\nEarn 1999-12-31 2000-01-06 20\nComputeIncome 2000-01-01 2001-01-01\n", {0}},
+    {"2\nEarn 2000-01-06 2000-01-02 20\nComputeIncome 2000-01-01 2001-01-01\n", {0}},
+    // The income is spread over 31 days, the last of them past the calendar
+    {"3\nEarn 2099-12-02 2100-01-01 31\nComputeIncome 2099-01-01 2100-01-01\nComputeIncome 2099-12-31 2100-01-01\n", {30, 1}},
+    {"2\nEarn 2000-01-02 2000-01-06 20\nComputeIncome 2000-01-01 2100-01-01\n", {20}},
+  };
+  for (const auto& [input, expected] : cases) {
+    istringstream in_stream(input);
+    const auto requests = ReadRequests(in_stream);
+    ASSERT_EQUAL(ProcessRequestsOnline(requests), expected);
+    ASSERT_EQUAL(ProcessRequestsInBatch(requests), expected);
+    ASSERT_EQUAL(ProcessRequestsByAccount(requests), expected);
+  }
+}
+
+void TestPrintResponses() {
+  mt19937 generator{5};
+  uniform_real_distribution<double> value{-1e12, 1e12};
+  vector<double> responses{0, -0.0, 1, 0.5, 1e-7, 123456789012345678.0, 1.0 / 3};
+  for (size_t i = 0; i < 1000; ++i) {
+    responses.push_back(value(generator));
+  }
+  for (const int precision : {6, 25}) {
+    ostringstream expected;
+    expected.precision(precision);
+    for (const double response : responses) {
+      expected << response << endl;
+    }
+    ostringstream actual;
+    actual.precision(precision);
+    PrintResponses(responses, actual);
+    ASSERT_EQUAL(actual.str(), expected.str());
+  }
+}
+
+void BenchmarkReadAndPrint() {
+  const string input = MakeRandomInput(1'000'000, 9);
+  size_t checksum = 0;
+  {
+    LOG_DURATION("1M requests, getline and ParseRequest per line");
+    istringstream in_stream(input);
+    const size_t request_count = ReadNumberOnLine<size_t>(in_stream);
+    for (size_t i = 0; i < request_count; ++i) {
+      string request_str;
+      getline(in_stream, request_str);
+      checksum += ParseRequest(request_str)->day_to;
+    }
+  }
+  {
+    LOG_DURATION("1M requests, ReadRequests");
+    istringstream in_stream(input);
+    for (const auto& request : ReadRequests(in_stream)) {
+      checksum -= request.day_to;
+    }
+  }
+  cerr << "Reading checksum difference: " << checksum << endl;
+
+  mt19937 generator{9};
+  uniform_real_distribution<double> value{-1e12, 1e12};
+  vector<double> responses(1'000'000);
+  for (auto& response : responses) {
+    response = value(generator);
+  }
+  ostringstream expected;
+  expected.precision(25);
+  {
+    LOG_DURATION("1M responses, stream << response << endl");
+    for (const double response : responses) {
+      expected << response << endl;
+    }
+  }
+  ostringstream actual;
+  actual.precision(25);
+  {
+    LOG_DURATION("1M responses, PrintResponses");
+    PrintResponses(responses, actual);
+  }
+  cerr << "Printed the same: " << boolalpha << (actual.str() == expected.str()) << endl;
+}
+
+void TestParseAccount() {
+  ASSERT_EQUAL(ParseRequest("Earn 2000-01-02 2000-01-06 20")->account, DEFAULT_ACCOUNT);
+  ASSERT_EQUAL(ParseRequest("42 Earn 2000-01-02 2000-01-06 20")->account, 42u);
+  ASSERT_EQUAL(ParseRequest("18446744073709551615 ComputeIncome 2000-01-01 2001-01-01")->account,
+               numeric_limits<AccountId>::max());
+  ASSERT_THROWS([] { ParseRequest("42x Earn 2000-01-02 2000-01-06 20"); });
+}
+
+void TestAccountsMatchSeparateBudgets() {
+  // Few accounts grow trees, many accounts stay with operation logs
+  for (const size_t account_count : {1, 20, 500}) {
+    const unsigned int seed = static_cast<unsigned int>(account_count);
+    auto requests = MakeRandomRequests(3000, 1, 100, 400, seed);
+
+    vector<vector<Request>> requests_by_account(account_count);
+    vector<size_t> response_accounts;
+    for (size_t i = 0; i < requests.size(); ++i) {
+      const size_t account = i * 7 % account_count;
+      requests_by_account[account].push_back(requests[i]);
+      requests[i].account = account + 1;
+      if (requests[i].type == Request::Type::COMPUTE_INCOME) {
+        response_accounts.push_back(account);
+      }
+    }
+
+    vector<vector<double>> responses_by_account;
+    for (const auto& account_requests : requests_by_account) {
+      auto responses = ProcessRequestsOnline(account_requests);
+      reverse(begin(responses), end(responses));
+      responses_by_account.push_back(move(responses));
+    }
+    vector<double> expected;
+    for (const size_t account : response_accounts) {
+      expected.push_back(responses_by_account[account].back());
+      responses_by_account[account].pop_back();
+    }
+
+    AssertSameResponses(ProcessRequests(requests), expected);
+  }
+
+  // A logged account clamps queries like an account with a tree
+  MultiAccountBudgetManager manager;
+  BudgetManager budget;
+  const IndexSegment past_end{DAY_COUNT - 30, DAY_COUNT + 1};
+  manager.AddBulkOperation(1, past_end, BulkMoneyAdder{20.0 / 31});
+  budget.AddBulkOperation(past_end, BulkMoneyAdder{20.0 / 31});
+  for (const IndexSegment segment : {past_end, IndexSegment{0, DAY_COUNT + 5}, IndexSegment{DAY_COUNT, DAY_COUNT + 1}}) {
+    // Tighter than ASSERT_EQUAL, a day too many is off by only 20 / 31 / 1000
+    ASSERT(abs(manager.ComputeSum(1, segment) - budget.ComputeSum(segment)) < 1e-9);
+  }
+}
+
+void BenchmarkSnapshotReaders() {
+  const auto operations = MakeRandomOperations(1'000'000, DAY_COUNT, 13);
+  PublishingBudgetManager manager;
+  RunOperations(manager, operations);
+  manager.Publish();
+
+  vector<IndexSegment> queries;
+  for (const auto& operation : operations) {
+    queries.push_back(operation.segment);
+  }
+  const auto read = [&](size_t first, size_t last) {
+    const auto snapshot = manager.GetSnapshot();
+    double sum = 0;
+    for (size_t i = first; i < last; ++i) {
+      sum += snapshot.ComputeSum(queries[i]);
+    }
+    return sum;
+  };
+
+  for (const bool with_writer : {false, true}) {
+    for (const size_t thread_count : {1, 2, 4, 8}) {
+      LOG_DURATION("1M snapshot queries, " + to_string(thread_count) + " readers" + (with_writer ? " and a writer" : ""));
+      atomic<bool> done = false;
+      future<void> writer;
+      if (with_writer) {
+        writer = async(launch::async, [&] {
+          for (size_t i = 0; !done; i = (i + 1) % operations.size()) {
+            manager.AddBulkOperation(operations[i].segment, BulkMoneyAdder{1});
+            if (i % 100 == 0) {
+              manager.Publish();
+            }
+          }
+        });
+      }
+      vector<future<double>> readers;
+      for (size_t i = 0; i < thread_count; ++i) {
+        readers.push_back(async(launch::async, read, queries.size() * i / thread_count, queries.size() * (i + 1) / thread_count));
+      }
+      double checksum = 0;
+      for (auto& reader : readers) {
+        checksum += reader.get();
+      }
+      done = true;
+      if (writer.valid()) {
+        writer.get();
+      }
+      cerr << "Checksum: " << checksum << endl;
+    }
+  }
+}
+
+void BenchmarkManyAccounts() {
+  const size_t account_count = 1'000'000;
+  mt19937 generator{11};
+  uniform_int_distribution<size_t> position{0, DAY_COUNT - 1};
+  uniform_int_distribution<size_t> length{1, 400};
+  uniform_int_distribution<size_t> operation_count{1, 4};
+  uniform_real_distribution<double> amount{1, 1e6};
+  const auto make_segment = [&] {
+    const size_t left = position(generator);
+    return IndexSegment{left, min(DAY_COUNT, left + length(generator))};
+  };
+
+  MultiAccountBudgetManager manager;
+  {
+    LOG_DURATION("1M accounts, 1-4 operations each");
+    for (AccountId account = 1; account <= account_count; ++account) {
+      for (size_t i = operation_count(generator); i > 0; --i) {
+        const auto segment = make_segment();
+        manager.AddBulkOperation(account, segment, BulkMoneyAdder{amount(generator) / segment.length()});
+      }
+    }
+    // A few busy accounts switch to trees
+    for (AccountId account = 1; account <= account_count; account += 1000) {
+      for (size_t i = 0; i < 100; ++i) {
+        const auto segment = make_segment();
+        manager.AddBulkOperation(account, segment, BulkMoneySpender{amount(generator) / segment.length()});
+      }
+    }
+  }
+  double checksum = 0;
+  {
+    LOG_DURATION("1M queries over 1M accounts");
+    uniform_int_distribution<AccountId> account{1, account_count};
+    for (size_t i = 0; i < 1'000'000; ++i) {
+      checksum += manager.ComputeSum(account(generator), make_segment());
+    }
+  }
+  cerr << "Accounts: " << manager.AccountCount() << ", tree nodes: " << manager.TreeNodeCount()
+       << ", bytes per account: " << manager.MemoryUsage() / manager.AccountCount()
+       << ", checksum: " << checksum << endl;
+}
+
+void TestAll() {
+  TestRunner tr;
+  RUN_TEST(tr, TestArrayTreeMatchesPointerTree);
+  RUN_TEST(tr, TestBatchMatchesOnline);
+  RUN_TEST(tr, TestBatchSelection);
+  RUN_TEST(tr, TestRangeFenwickTree);
+  RUN_TEST(tr, TestBudgetBackends);
+  RUN_TEST(tr, TestFixedMoney);
+  RUN_TEST(tr, TestFixedTreeIsExact);
+  RUN_TEST(tr, TestFixedTreeMatchesDoubleTree);
+  RUN_TEST(tr, TestSparseTreeMatchesArrayTree);
+  RUN_TEST(tr, TestPersistentTreeMatchesArrayTree);
+  RUN_TEST(tr, TestSnapshotsKeepTheirVersion);
+  RUN_TEST(tr, TestDayIndexMatchesMktime);
+  RUN_TEST(tr, TestDateParsing);
+  RUN_TEST(tr, TestReadRequests);
+  RUN_TEST(tr, TestRequestsOutsideCalendar);
+  RUN_TEST(tr, TestPrintResponses);
+  RUN_TEST(tr, TestParseAccount);
+  RUN_TEST(tr, TestAccountsMatchSeparateBudgets);
+  BenchmarkSegmentTrees();
+  BenchmarkBatchProcessing();
+  BenchmarkManyAccounts();
+  BenchmarkSnapshotReaders();
+  BenchmarkDateParsing();
+  BenchmarkReadAndPrint();
+  BenchmarkBudgetBackends();
+  BenchmarkFixedMoney();
+}
+#endif
+
+
+int main() {
+#ifdef BUDGET_MOBILE_TEST
+  TestAll();
+#endif
+
   cout.precision(25);
   const auto requests = ReadRequests();
   const auto responses = ProcessRequests(requests);
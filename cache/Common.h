@@ -21,7 +21,9 @@ class IBooksUnpacker {
 public:
   virtual ~IBooksUnpacker() = default;
 
-  // Распаковывает книгу с указанным названием из хранилища
+  // Распаковывает книгу с указанным названием из хранилища. Кэш не держит
+  // блокировок во время распаковки, поэтому метод может вызываться
+  // одновременно из нескольких потоков для разных книг
   virtual std::unique_ptr<IBook> UnpackBook(const std::string& book_name) = 0;
 };
 
@@ -30,9 +32,27 @@ class ICache {
 public:
   // Настройки кэша
   struct Settings {
+    // Стратегия вытеснения книг из кэша
+    enum class Policy {
+      // Вытесняются книги, к которым дольше всего не обращались
+      LRU,
+      // Новые книги попадают в небольшое окно (1% max_memory), а из него
+      // в основную часть, только если их запрашивали чаще, чем вытесняемые
+      // оттуда. Однократный просмотр всего каталога не вытесняет популярные
+      // книги
+      W_TINY_LFU,
+    };
+
     // Максимальный допустимый объём памяти, потребляемый закэшированными
     // объектами, в байтах
     size_t max_memory = 0;
+
+    // Количество независимых частей кэша, каждая со своей блокировкой.
+    // Книги распределяются по частям по хешу названия, и каждой части
+    // достаётся равная доля max_memory
+    size_t shard_count = 1;
+
+    Policy policy = Policy::LRU;
   };
 
   using BookPtr = std::shared_ptr<const IBook>;
@@ -1,83 +1,258 @@
 #include "Common.h"
 
 #include <unordered_map>
-#include <set>
 #include <iostream>
-#include <chrono>
+#include <array>
+#include <cstdint>
+#include <future>
 #include <mutex>
+#include <vector>
 
 using namespace std;
 
-class LruCache : public ICache {
+// Approximate counts of recent accesses to books: four rows of small
+// counters, a book increments one counter in every row and its estimate is
+// the smallest of them. All counters are halved after every
+// SAMPLES_PER_COUNTER * WIDTH accesses, so old popularity fades.
+class FrequencySketch {
 public:
-  LruCache(
+  void Increment(size_t hash) {
+    for (size_t row = 0; row < ROW_COUNT; ++row) {
+      uint8_t& counter = counters_[Index(hash, row)];
+      if (counter < MAX_COUNT) {
+        ++counter;
+      }
+    }
+    if (++samples_ == SAMPLES_PER_COUNTER * WIDTH) {
+      Age();
+    }
+  }
+
+  uint8_t Estimate(size_t hash) const {
+    uint8_t result = MAX_COUNT;
+    for (size_t row = 0; row < ROW_COUNT; ++row) {
+      result = min(result, counters_[Index(hash, row)]);
+    }
+    return result;
+  }
+
+private:
+  static constexpr size_t ROW_COUNT = 4;
+  static constexpr size_t WIDTH_BITS = 15;
+  static constexpr size_t WIDTH = size_t{1} << WIDTH_BITS;
+  static constexpr size_t SAMPLES_PER_COUNTER = 10;
+  static constexpr uint8_t MAX_COUNT = 15;
+  static constexpr array<uint64_t, ROW_COUNT> SEEDS = {
+    0x9E3779B97F4A7C15, 0xC2B2AE3D27D4EB4F, 0x165667B19E3779F9, 0xD6E8FEB86659FD93,
+  };
+
+  // Rows one after another
+  vector<uint8_t> counters_ = vector<uint8_t>(ROW_COUNT * WIDTH);
+  size_t samples_ = 0;
+
+  static size_t Index(size_t hash, size_t row) {
+    return row * WIDTH + ((static_cast<uint64_t>(hash) * SEEDS[row]) >> (64 - WIDTH_BITS));
+  }
+
+  void Age() {
+    for (uint8_t& counter : counters_) {
+      counter /= 2;
+    }
+    samples_ = 0;
+  }
+};
+
+class SingleLockCache : public ICache {
+public:
+  SingleLockCache(
       shared_ptr<IBooksUnpacker> books_unpacker,
       const Settings& settings
   )
     : books_unpacker_(move(books_unpacker))
     , settings_(settings)
   {
+    if (settings_.policy == Settings::Policy::W_TINY_LFU) {
+      window_.max_memory = settings_.max_memory / 100;
+      main_.max_memory = settings_.max_memory - window_.max_memory;
+    } else {
+      window_.max_memory = settings_.max_memory;
+    }
   }
 
+  // Books are unpacked outside of the lock, so hits do not wait for a slow
+  // miss, and threads missing the same book wait for a single unpacking
   BookPtr GetBook(const string& book_name) override {
-    lock_guard<mutex> lock(books_mutex_);
-    Priority priority{book_name, chrono::steady_clock::now()};
-
-    if (books_.count(book_name)) {
-      auto& item = books_.at(book_name);
-
-      use_times_.erase(item.first);
-      use_times_.insert(priority);
-
-      item.first = priority;
+    shared_future<BookPtr> in_flight;
+    promise<BookPtr> unpacked;
+    {
+      lock_guard<mutex> lock(books_mutex_);
+      if (settings_.policy == Settings::Policy::W_TINY_LFU) {
+        frequencies_.Increment(hasher_(book_name));
+      }
+      if (auto it = books_.find(book_name); it != books_.end()) {
+        auto& entry = it->second;
+        LruList& list = *entry.list;
+        list.Unlink(entry);
+        list.PushNewest(entry);
+        return entry.book;
+      }
 
-      return item.second;
+      if (auto it = unpacking_books_.find(book_name); it != unpacking_books_.end()) {
+        in_flight = it->second;
+      } else {
+        unpacking_books_.emplace(book_name, unpacked.get_future().share());
+      }
     }
 
-    auto unpacked_book = books_unpacker_->UnpackBook(book_name);
-    BookPtr res{unpacked_book.release()};
+    if (in_flight.valid()) {
+      return in_flight.get();
+    }
 
-    if (res->GetContent().size() <= settings_.max_memory) {
+    BookPtr res;
+    try {
+      res = books_unpacker_->UnpackBook(book_name);
+    } catch (...) {
       {
-        auto lru_begin = use_times_.begin();
-        auto lru_end = lru_begin;
-
-        while (memory_used > 0 &&
-               memory_used + res->GetContent().size() > settings_.max_memory) {
-          memory_used -= books_.at(lru_end->key).second->GetContent().size();
-          books_.erase(lru_end->key);
-          ++lru_end;
-        }
-
-        use_times_.erase(lru_begin, lru_end);
+        lock_guard<mutex> lock(books_mutex_);
+        unpacking_books_.erase(book_name);
       }
+      unpacked.set_exception(current_exception());
+      throw;
+    }
 
-      memory_used += res->GetContent().size();
-      books_[book_name] = {priority, res};
-      use_times_.insert(priority);
+    {
+      lock_guard<mutex> lock(books_mutex_);
+      unpacking_books_.erase(book_name);
+      AddBook(book_name, res);
     }
+    unpacked.set_value(res);
 
     return res;
   }
 
 private:
-  struct Priority {
-    string key;
-    chrono::time_point<chrono::steady_clock> time;
+  struct LruList;
+
+  struct Entry {
+    BookPtr book;
+    Entry* newer = nullptr;
+    Entry* older = nullptr;
+    const string* name = nullptr;
+    LruList* list = nullptr;
   };
 
-  struct PriorityLess {
-    bool operator()(const Priority& lhs, const Priority& rhs) const {
-      return lhs.time < rhs.time;
+  // Books form lists from the most to the least recently used one right in
+  // the map: its nodes are never moved, so a hit only relinks two pointers
+  struct LruList {
+    Entry* newest = nullptr;
+    Entry* oldest = nullptr;
+    size_t memory = 0;
+    size_t max_memory = 0;
+
+    void Unlink(Entry& entry) {
+      (entry.newer ? entry.newer->older : newest) = entry.older;
+      (entry.older ? entry.older->newer : oldest) = entry.newer;
+      entry.newer = entry.older = nullptr;
+      entry.list = nullptr;
+      memory -= entry.book->GetContent().size();
+    }
+
+    void PushNewest(Entry& entry) {
+      entry.older = newest;
+      (newest ? newest->newer : oldest) = &entry;
+      newest = &entry;
+      entry.list = this;
+      memory += entry.book->GetContent().size();
     }
   };
 
   shared_ptr<IBooksUnpacker> books_unpacker_;
   Settings settings_;
-  size_t memory_used{0};
-  unordered_map<string, pair<Priority, BookPtr>> books_;
-  set<Priority, PriorityLess> use_times_;
+  unordered_map<string, Entry> books_;
+  // New books come to the window. With LRU it is the whole cache; with
+  // W-TinyLFU books pushed out of it replace books of the main list only if
+  // they are requested more often.
+  LruList window_;
+  LruList main_;
+  hash<string> hasher_;
+  FrequencySketch frequencies_;
+  // Books being unpacked by some thread right now
+  unordered_map<string, shared_future<BookPtr>> unpacking_books_;
   mutex books_mutex_;
+
+  void RemoveBook(Entry& entry) {
+    entry.list->Unlink(entry);
+    books_.erase(books_.find(*entry.name));
+  }
+
+  void AddBook(const string& book_name, BookPtr book) {
+    if (book->GetContent().size() > settings_.max_memory) {
+      return;
+    }
+
+    const auto it = books_.emplace(book_name, Entry{move(book)}).first;
+    it->second.name = &it->first;
+    window_.PushNewest(it->second);
+
+    while (window_.memory > window_.max_memory) {
+      Entry& candidate = *window_.oldest;
+      window_.Unlink(candidate);
+      if (Admit(candidate)) {
+        main_.PushNewest(candidate);
+      } else {
+        books_.erase(books_.find(*candidate.name));
+      }
+    }
+  }
+
+  // The candidate replaces the least recently used books of the main list
+  // only if it is more popular than each of them. All of them are compared
+  // before any is evicted, so a rejected candidate leaves the list intact
+  bool Admit(const Entry& candidate) {
+    const size_t size = candidate.book->GetContent().size();
+    if (size > main_.max_memory) {
+      return false;
+    }
+    const uint8_t frequency = frequencies_.Estimate(hasher_(*candidate.name));
+    size_t free_memory = main_.max_memory - main_.memory;
+    Entry* kept = main_.oldest;
+    for (; free_memory < size; kept = kept->newer) {
+      if (frequencies_.Estimate(hasher_(*kept->name)) >= frequency) {
+        return false;
+      }
+      free_memory += kept->book->GetContent().size();
+    }
+    while (main_.oldest != kept) {
+      RemoveBook(*main_.oldest);
+    }
+    return true;
+  }
+};
+
+// Books are spread over independent caches by the hash of their names, so
+// threads reading different books rarely wait for the same lock. Every shard
+// gets an equal part of the memory limit.
+class ShardedCache : public ICache {
+public:
+  ShardedCache(
+      shared_ptr<IBooksUnpacker> books_unpacker,
+      const Settings& settings
+  ) {
+    Settings shard_settings = settings;
+    shard_settings.max_memory = settings.max_memory / settings.shard_count;
+    shards_.reserve(settings.shard_count);
+    for (size_t i = 0; i < settings.shard_count; ++i) {
+      shards_.push_back(make_unique<SingleLockCache>(books_unpacker, shard_settings));
+    }
+  }
+
+  BookPtr GetBook(const string& book_name) override {
+    return shards_[hasher_(book_name) % shards_.size()]->GetBook(book_name);
+  }
+
+private:
+  hash<string> hasher_;
+  vector<unique_ptr<SingleLockCache>> shards_;
 };
 
 
@@ -85,5 +260,8 @@ unique_ptr<ICache> MakeCache(
     shared_ptr<IBooksUnpacker> books_unpacker,
     const ICache::Settings& settings
 ) {
-  return make_unique<LruCache>(move(books_unpacker), settings);
+  if (settings.shard_count > 1) {
+    return make_unique<ShardedCache>(move(books_unpacker), settings);
+  }
+  return make_unique<SingleLockCache>(move(books_unpacker), settings);
 }
@@ -1,11 +1,16 @@
 #include "Common.h"
 #include "test_runner.h"
+#include "profile.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <fstream>
 #include <future>
 #include <numeric>
 #include <random>
 #include <sstream>
+#include <thread>
 
 using namespace std;
 
@@ -78,6 +83,23 @@ private:
   atomic<int> unpacked_books_count_ = 0;
 };
 
+// Unpacks every book for the given time, as a large compressed book would
+class SlowBooksUnpacker : public BooksUnpacker {
+public:
+  explicit SlowBooksUnpacker(chrono::milliseconds delay)
+    : delay_(delay)
+  {
+  }
+
+  unique_ptr<IBook> UnpackBook(const string& book_name) override {
+    this_thread::sleep_for(delay_);
+    return BooksUnpacker::UnpackBook(book_name);
+  }
+
+private:
+  chrono::milliseconds delay_;
+};
+
 struct Library {
   vector<string> book_names;
   unordered_map<string, unique_ptr<IBook>> content;
@@ -104,9 +126,31 @@ void TestUnpacker(const Library& lib) {
 }
 
 
-void TestMaxMemory(const Library& lib) {
+// Policy and shard count every generic test runs with, max_memory is set by
+// the test itself
+vector<ICache::Settings> MakeSettingsVariants() {
+  vector<ICache::Settings> variants;
+  for (const auto policy : {ICache::Settings::Policy::LRU, ICache::Settings::Policy::W_TINY_LFU}) {
+    for (const size_t shard_count : {1, 4}) {
+      ICache::Settings settings;
+      settings.policy = policy;
+      settings.shard_count = shard_count;
+      variants.push_back(settings);
+    }
+  }
+  return variants;
+}
+
+string DescribeSettings(const ICache::Settings& settings) {
+  ostringstream description;
+  description << (settings.policy == ICache::Settings::Policy::LRU ? "LRU" : "W-TinyLFU")
+              << ", " << settings.shard_count << " shards";
+  return description.str();
+}
+
+
+void TestMaxMemory(const Library& lib, ICache::Settings settings) {
   auto unpacker = make_shared<BooksUnpacker>();
-  ICache::Settings settings;
   settings.max_memory = lib.size_in_bytes / 2;
   auto cache = MakeCache(unpacker, settings);
 
@@ -117,9 +161,8 @@ void TestMaxMemory(const Library& lib) {
 }
 
 
-void TestCaching(const Library& lib) {
+void TestCaching(const Library& lib, ICache::Settings settings) {
   auto unpacker = make_shared<BooksUnpacker>();
-  ICache::Settings settings;
   settings.max_memory = lib.size_in_bytes;
   auto cache = MakeCache(unpacker, settings);
 
@@ -135,9 +178,8 @@ void TestCaching(const Library& lib) {
 }
 
 
-void TestSmallCache(const Library& lib) {
+void TestSmallCache(const Library& lib, ICache::Settings settings) {
   auto unpacker = make_shared<BooksUnpacker>();
-  ICache::Settings settings;
   settings.max_memory =
       unpacker->UnpackBook(lib.book_names[0])->GetContent().size() - 1;
   auto cache = MakeCache(unpacker, settings);
@@ -147,12 +189,32 @@ void TestSmallCache(const Library& lib) {
 }
 
 
-void TestAsync(const Library& lib) {
+void TestEvictsLeastRecentlyUsed(const Library&) {
+  // Books with names of the same length have the same size
+  auto unpacker = make_shared<BooksUnpacker>();
+  ICache::Settings settings;
+  settings.max_memory = 3 * unpacker->UnpackBook("Book 1")->GetContent().size();
+  auto cache = MakeCache(unpacker, settings);
+
+  for (const auto& book_name : {"Book 1", "Book 2", "Book 3", "Book 1", "Book 4"}) {
+    cache->GetBook(book_name);
+  }
+  const int unpacked_books_count = unpacker->GetUnpackedBooksCount();
+
+  for (const auto& book_name : {"Book 1", "Book 3", "Book 4"}) {
+    cache->GetBook(book_name);
+  }
+  ASSERT_EQUAL(unpacker->GetUnpackedBooksCount(), unpacked_books_count);
+  cache->GetBook("Book 2");
+  ASSERT_EQUAL(unpacker->GetUnpackedBooksCount(), unpacked_books_count + 1);
+}
+
+
+void TestAsync(const Library& lib, ICache::Settings settings) {
   static const int tasks_count = 10;
   static const int trials_count = 10000;
 
   auto unpacker = make_shared<BooksUnpacker>();
-  ICache::Settings settings;
   settings.max_memory = lib.size_in_bytes - 1;
   auto cache = MakeCache(unpacker, settings);
 
@@ -182,7 +244,276 @@ void TestAsync(const Library& lib) {
 }
 
 
-int main() {
+void TestShards(const Library& lib) {
+  auto unpacker = make_shared<BooksUnpacker>();
+  ICache::Settings settings;
+  settings.max_memory = lib.size_in_bytes;
+  settings.shard_count = 4;
+  auto cache = MakeCache(unpacker, settings);
+
+  for (const auto& book_name : lib.book_names) {
+    ASSERT_EQUAL(cache->GetBook(book_name)->GetName(), book_name);
+    ASSERT(unpacker->GetMemoryUsedByBooks() <= settings.max_memory);
+  }
+
+  // Every shard fits a few books, so the last requested one is still cached
+  const int unpacked_books_count = unpacker->GetUnpackedBooksCount();
+  cache->GetBook(lib.book_names.back());
+  ASSERT_EQUAL(unpacker->GetUnpackedBooksCount(), unpacked_books_count);
+}
+
+
+void TestRejectedCandidateKeepsMainList(const Library&) {
+  // A book is 26 bytes longer than its name. The main list holds 198 bytes
+  // and the window none, so every new book is a candidate for the main list
+  auto unpacker = make_shared<BooksUnpacker>();
+  ICache::Settings settings;
+  settings.max_memory = 200;
+  settings.policy = ICache::Settings::Policy::W_TINY_LFU;
+  auto cache = MakeCache(unpacker, settings);
+
+  const string cold(24, 'a');
+  const string hot(114, 'b');
+  const string candidate(74, 'c');
+  cache->GetBook(cold);
+  for (int i = 0; i < 5; ++i) {
+    cache->GetBook(hot);
+  }
+  // The candidate needs the room of both books; it is more popular than the
+  // cold one but not than the hot one, so neither is evicted
+  cache->GetBook(candidate);
+  cache->GetBook(candidate);
+
+  const int unpacked_books_count = unpacker->GetUnpackedBooksCount();
+  cache->GetBook(cold);
+  cache->GetBook(hot);
+  ASSERT_EQUAL(unpacker->GetUnpackedBooksCount(), unpacked_books_count);
+}
+
+
+void TestSingleUnpackingPerMiss(const Library& lib) {
+  auto unpacker = make_shared<SlowBooksUnpacker>(chrono::milliseconds(100));
+  ICache::Settings settings;
+  settings.max_memory = lib.size_in_bytes;
+  auto cache = MakeCache(unpacker, settings);
+
+  vector<future<ICache::BookPtr>> tasks;
+  for (int task_num = 0; task_num < 8; ++task_num) {
+    tasks.push_back(async(launch::async, [&cache, &lib] {
+      return cache->GetBook(lib.book_names[0]);
+    }));
+  }
+  const auto book = tasks.front().get();
+  for (size_t i = 1; i < tasks.size(); ++i) {
+    ASSERT(tasks[i].get() == book);
+  }
+  ASSERT_EQUAL(unpacker->GetUnpackedBooksCount(), 1);
+}
+
+
+void TestHitLatencyDuringSlowMisses(const Library& lib) {
+  static const int miss_thread_count = 4;
+  static const auto unpacking_time = chrono::milliseconds(200);
+  static const auto measuring_time = chrono::milliseconds(1000);
+  static const auto hit_period = chrono::milliseconds(1);
+
+  auto unpacker = make_shared<SlowBooksUnpacker>(unpacking_time);
+  ICache::Settings settings;
+  // Missed books never push the cached ones out
+  settings.max_memory = lib.size_in_bytes * 1000;
+  auto cache = MakeCache(unpacker, settings);
+  for (const auto& book_name : lib.book_names) {
+    cache->GetBook(book_name);
+  }
+
+  atomic<bool> done = false;
+  vector<future<chrono::steady_clock::duration>> misses;
+  for (int task_num = 0; task_num < miss_thread_count; ++task_num) {
+    misses.push_back(async(launch::async, [&cache, &done, task_num] {
+      auto fastest_miss = chrono::steady_clock::duration::max();
+      for (int i = 0; !done; ++i) {
+        const auto miss_start = chrono::steady_clock::now();
+        cache->GetBook("Missing book #" + to_string(task_num) + "-" + to_string(i));
+        fastest_miss = min(fastest_miss, chrono::steady_clock::now() - miss_start);
+      }
+      return fastest_miss;
+    }));
+  }
+
+  // Hits are requested at a fixed rate and their latency is counted from
+  // the planned time, so a hit stuck behind a miss delays the following ones
+  vector<chrono::steady_clock::duration> hit_latencies;
+  const auto start = chrono::steady_clock::now();
+  for (size_t i = 0; i * hit_period < measuring_time; ++i) {
+    const auto planned_time = start + i * hit_period;
+    this_thread::sleep_until(planned_time);
+    cache->GetBook(lib.book_names[i % lib.book_names.size()]);
+    hit_latencies.push_back(chrono::steady_clock::now() - planned_time);
+  }
+  done = true;
+  auto fastest_miss = chrono::steady_clock::duration::max();
+  for (auto& task : misses) {
+    fastest_miss = min(fastest_miss, task.get());
+  }
+
+  const size_t p99_index = hit_latencies.size() * 99 / 100;
+  nth_element(hit_latencies.begin(), hit_latencies.begin() + p99_index, hit_latencies.end());
+  const auto p99 = hit_latencies[p99_index];
+  cerr << "p99 hit latency during misses: " << chrono::duration_cast<chrono::microseconds>(p99).count()
+       << " us, fastest miss: " << chrono::duration_cast<chrono::microseconds>(fastest_miss).count() << " us" << endl;
+  // Timings depend on the machine, so only their order is checked: hits
+  // that wait for unpackings fall behind by more than a whole miss
+  ASSERT(p99 < fastest_miss);
+  // Misses were in progress during the measurement
+  ASSERT(unpacker->GetUnpackedBooksCount() > static_cast<int>(lib.book_names.size()));
+}
+
+
+void TestScanResistance(const Library&) {
+  static const size_t hot_book_count = 100;
+  static const size_t catalog_size = 10'000;
+
+  for (const auto policy : {ICache::Settings::Policy::LRU, ICache::Settings::Policy::W_TINY_LFU}) {
+    auto unpacker = make_shared<BooksUnpacker>();
+    ICache::Settings settings;
+    settings.max_memory = 2 * hot_book_count * unpacker->UnpackBook("Hot book #00")->GetContent().size();
+    settings.policy = policy;
+    auto cache = MakeCache(unpacker, settings);
+
+    const auto hot_book = [](size_t i) {
+      return "Hot book #" + to_string(i / 10) + to_string(i % 10);
+    };
+    for (int round = 0; round < 3; ++round) {
+      for (size_t i = 0; i < hot_book_count; ++i) {
+        cache->GetBook(hot_book(i));
+      }
+    }
+    for (size_t i = 0; i < catalog_size; ++i) {
+      cache->GetBook("Catalog book #" + to_string(i));
+      ASSERT(unpacker->GetMemoryUsedByBooks() <= settings.max_memory);
+    }
+
+    const int unpacked_books_count = unpacker->GetUnpackedBooksCount();
+    for (size_t i = 0; i < hot_book_count; ++i) {
+      cache->GetBook(hot_book(i));
+    }
+    const size_t misses = unpacker->GetUnpackedBooksCount() - unpacked_books_count;
+    if (policy == ICache::Settings::Policy::LRU) {
+      ASSERT_EQUAL(misses, hot_book_count);
+    } else {
+      ASSERT(misses <= hot_book_count / 10);
+    }
+  }
+}
+
+
+// Replays the trace of requested book names through a cache with every
+// policy and reports the share of hits and the speed
+void ReplayTrace(const string& title, const vector<string>& trace, size_t max_memory) {
+  for (const auto& [policy, policy_name] : {
+      pair{ICache::Settings::Policy::LRU, "LRU"},
+      pair{ICache::Settings::Policy::W_TINY_LFU, "W-TinyLFU"},
+  }) {
+    auto unpacker = make_shared<BooksUnpacker>();
+    ICache::Settings settings;
+    settings.max_memory = max_memory;
+    settings.policy = policy;
+    auto cache = MakeCache(unpacker, settings);
+
+    const auto start = chrono::steady_clock::now();
+    for (const auto& book_name : trace) {
+      cache->GetBook(book_name);
+    }
+    const auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+
+    const size_t hits = trace.size() - unpacker->GetUnpackedBooksCount();
+    cerr << title << ", " << policy_name << ": "
+         << 100.0 * hits / trace.size() << "% hits, "
+         << trace.size() / max<chrono::milliseconds::rep>(duration.count(), 1) << " requests/ms" << endl;
+  }
+}
+
+// Popular books are requested by Zipf's law, and every scan_period
+// requests the whole catalog is read once
+vector<string> MakeTrace(size_t request_count, size_t book_count, size_t scan_period) {
+  vector<double> weights(book_count);
+  for (size_t i = 0; i < book_count; ++i) {
+    weights[i] = 1.0 / (i + 1);
+  }
+  default_random_engine gen;
+  discrete_distribution<size_t> dis(weights.begin(), weights.end());
+
+  vector<string> trace;
+  trace.reserve(request_count);
+  while (trace.size() < request_count) {
+    trace.push_back("Book #" + to_string(dis(gen)));
+    if (scan_period > 0 && trace.size() % scan_period == 0) {
+      for (size_t i = 0; i < book_count && trace.size() < request_count; ++i) {
+        trace.push_back("Book #" + to_string(i));
+      }
+    }
+  }
+  return trace;
+}
+
+void BenchmarkPolicies() {
+  static const size_t request_count = 500'000;
+  static const size_t book_count = 20'000;
+  const size_t max_memory = book_count / 20 * BooksUnpacker().UnpackBook("Book #10000")->GetContent().size();
+
+  ReplayTrace("Zipf", MakeTrace(request_count, book_count, 0), max_memory);
+  ReplayTrace("Zipf with scans", MakeTrace(request_count, book_count, 100'000), max_memory);
+}
+
+
+// Threads request uniformly random books of a catalog; the cache holds
+// hit_percentage of the catalog, so about as many requests are hits
+void BenchmarkShards() {
+  static const int thread_count = 8;
+  static const int requests_per_thread = 50'000;
+  static const size_t book_count = 10'000;
+
+  vector<string> book_names;
+  book_names.reserve(book_count);
+  size_t catalog_size = 0;
+  BooksUnpacker unpacker;
+  for (size_t i = 0; i < book_count; ++i) {
+    book_names.push_back("Book #" + to_string(i));
+    catalog_size += unpacker.UnpackBook(book_names.back())->GetContent().size();
+  }
+
+  for (size_t hit_percentage : {100, 90, 50}) {
+    for (size_t shard_count : {1, 16}) {
+      ICache::Settings settings;
+      settings.max_memory = catalog_size * hit_percentage / 100;
+      settings.shard_count = shard_count;
+      auto cache = MakeCache(make_shared<BooksUnpacker>(), settings);
+
+      ostringstream title;
+      title << thread_count << " threads, " << hit_percentage << "% hits, "
+            << shard_count << " shards";
+      LOG_DURATION(title.str());
+      vector<future<void>> tasks;
+      for (int task_num = 0; task_num < thread_count; ++task_num) {
+        tasks.push_back(async(launch::async, [&cache, &book_names, task_num] {
+          default_random_engine gen(task_num);
+          uniform_int_distribution<size_t> dis(0, book_names.size() - 1);
+          for (int i = 0; i < requests_per_thread; ++i) {
+            cache->GetBook(book_names[dis(gen)]);
+          }
+        }));
+      }
+      for (auto& task : tasks) {
+        task.get();
+      }
+    }
+  }
+}
+
+
+// With a trace file, one book name per line, and a memory limit in bytes
+// as arguments, also replays the trace
+int main(int argc, char* argv[]) {
   BooksUnpacker unpacker;
   const Library lib(
     // Названия книг для локального тестирования. В тестирующей системе курсеры
@@ -203,14 +534,37 @@ int main() {
   );
 
 #define RUN_CACHE_TEST(tr, f) tr.RunTest([&lib] { f(lib); }, #f)
+#define RUN_CACHE_TEST_FOR_SETTINGS(tr, f)                                                 \
+  for (const auto& settings : MakeSettingsVariants()) {                                    \
+    tr.RunTest([&lib, &settings] { f(lib, settings); }, #f " (" + DescribeSettings(settings) + ")"); \
+  }
 
   TestRunner tr;
   RUN_CACHE_TEST(tr, TestUnpacker);
-  RUN_CACHE_TEST(tr, TestMaxMemory);
-  RUN_CACHE_TEST(tr, TestCaching);
-  RUN_CACHE_TEST(tr, TestSmallCache);
-  RUN_CACHE_TEST(tr, TestAsync);
-
+  RUN_CACHE_TEST_FOR_SETTINGS(tr, TestMaxMemory);
+  RUN_CACHE_TEST_FOR_SETTINGS(tr, TestCaching);
+  RUN_CACHE_TEST_FOR_SETTINGS(tr, TestSmallCache);
+  RUN_CACHE_TEST(tr, TestEvictsLeastRecentlyUsed);
+  RUN_CACHE_TEST_FOR_SETTINGS(tr, TestAsync);
+  RUN_CACHE_TEST(tr, TestShards);
+  RUN_CACHE_TEST(tr, TestRejectedCandidateKeepsMainList);
+  RUN_CACHE_TEST(tr, TestSingleUnpackingPerMiss);
+  RUN_CACHE_TEST(tr, TestHitLatencyDuringSlowMisses);
+  RUN_CACHE_TEST(tr, TestScanResistance);
+
+#undef RUN_CACHE_TEST_FOR_SETTINGS
 #undef RUN_CACHE_TEST
+
+  BenchmarkShards();
+  BenchmarkPolicies();
+
+  if (argc == 3) {
+    ifstream trace_file(argv[1]);
+    vector<string> trace;
+    for (string book_name; getline(trace_file, book_name);) {
+      trace.push_back(move(book_name));
+    }
+    ReplayTrace(argv[1], trace, stoull(argv[2]));
+  }
   return 0;
 }
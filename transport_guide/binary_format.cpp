@@ -0,0 +1,303 @@
+#include "binary_format.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <variant>
+
+using namespace std;
+
+namespace BinaryArgs {
+
+namespace {
+
+const string_view MAGIC = "TGBR";
+const uint16_t VERSION = 1;
+
+enum class Section : uint8_t {
+  STOP_INFO = 1,
+  BUS_INFO = 2,
+  ROUTE_INFO = 3,
+};
+
+enum class ItemKind : uint8_t {
+  WAIT = 0,
+  BUS = 1,
+};
+
+class Writer {
+public:
+  explicit Writer(string& output) : output_(output) {}
+
+  template <typename T>
+  void WriteInt(T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      output_.push_back(static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xFF));
+    }
+  }
+
+  void WriteDouble(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    WriteInt(bits);
+  }
+
+  void WriteString(string_view value) {
+    WriteInt(static_cast<uint32_t>(value.size()));
+    output_.append(value);
+  }
+
+  // Writes a placeholder of type T to be patched once the size is known
+  template <typename T>
+  size_t StartSized() {
+    const size_t position = output_.size();
+    WriteInt(T{0});
+    return position;
+  }
+
+  template <typename T>
+  void FinishSized(size_t position) {
+    const auto size = static_cast<uint64_t>(output_.size() - position - sizeof(T));
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      output_[position + i] = static_cast<char>((size >> (8 * i)) & 0xFF);
+    }
+  }
+
+  void WriteHeader(uint64_t request_id, const optional<string>& error_message) {
+    WriteInt(request_id);
+    WriteInt(static_cast<uint8_t>(error_message.has_value()));
+    if (error_message) {
+      WriteString(*error_message);
+    }
+  }
+
+private:
+  string& output_;
+};
+
+class Reader {
+public:
+  explicit Reader(string_view data) : data_(data) {}
+
+  template <typename T>
+  T ReadInt() {
+    const auto bytes = Take(sizeof(T));
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      value |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+    }
+    return static_cast<T>(value);
+  }
+
+  double ReadDouble() {
+    const auto bits = ReadInt<uint64_t>();
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  string ReadString() {
+    return string{Take(ReadInt<uint32_t>())};
+  }
+
+  string_view Take(size_t size) {
+    if (size > data_.size()) {
+      throw invalid_argument("Truncated binary results");
+    }
+    const auto result = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return result;
+  }
+
+  // Reads a u32 count of items taking at least item_size bytes each; a count
+  // the remaining data cannot hold is rejected before anything is allocated
+  uint32_t ReadCount(size_t item_size) {
+    const auto count = ReadInt<uint32_t>();
+    CheckCount(count, item_size);
+    return count;
+  }
+
+  void CheckCount(size_t count, size_t item_size) const {
+    if (count > data_.size() / item_size) {
+      throw invalid_argument("Binary results count exceeds the data");
+    }
+  }
+
+  // Sub-reader over a u32 length-prefixed record
+  Reader ReadRecord() {
+    return Reader{Take(ReadInt<uint32_t>())};
+  }
+
+  optional<string> ReadHeader(size_t& request_id) {
+    request_id = static_cast<size_t>(ReadInt<uint64_t>());
+    if (ReadInt<uint8_t>()) {
+      return ReadString();
+    }
+    return nullopt;
+  }
+
+private:
+  string_view data_;
+};
+
+template <typename Info, typename WriteBody>
+void WriteSection(Writer& writer, Section kind, const vector<Info>& records, WriteBody write_body) {
+  writer.WriteInt(static_cast<uint8_t>(kind));
+  writer.WriteInt(static_cast<uint32_t>(records.size()));
+  const auto section = writer.StartSized<uint64_t>();
+  for (const auto& record : records) {
+    const auto position = writer.StartSized<uint32_t>();
+    writer.WriteHeader(record.request_id, record.error_message);
+    if (!record.error_message) {
+      write_body(record);
+    }
+    writer.FinishSized<uint32_t>(position);
+  }
+  writer.FinishSized<uint64_t>(section);
+}
+
+StopInfo ReadStopInfo(Reader& reader) {
+  StopInfo info;
+  info.error_message = reader.ReadHeader(info.request_id);
+  if (!info.error_message) {
+    // Every bus name is at least its u32 length
+    info.buses.resize(reader.ReadCount(sizeof(uint32_t)));
+    for (auto& bus : info.buses) {
+      bus = reader.ReadString();
+    }
+  }
+  return info;
+}
+
+BusInfo ReadBusInfo(Reader& reader) {
+  BusInfo info{};
+  info.error_message = reader.ReadHeader(info.request_id);
+  if (!info.error_message) {
+    info.route_length = static_cast<size_t>(reader.ReadInt<uint64_t>());
+    info.curvature = reader.ReadDouble();
+    info.stop_count = static_cast<size_t>(reader.ReadInt<uint64_t>());
+    info.unique_stop_count = static_cast<size_t>(reader.ReadInt<uint64_t>());
+  }
+  return info;
+}
+
+RouteInfo ReadRouteInfo(Reader& reader) {
+  RouteInfo info{};
+  info.error_message = reader.ReadHeader(info.request_id);
+  if (!info.error_message) {
+    info.total_time = reader.ReadDouble();
+    // Every item is at least its kind, time and name length
+    const auto item_count = reader.ReadCount(sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t));
+    info.items.reserve(item_count);
+    for (uint32_t i = 0; i < item_count; ++i) {
+      const auto kind = static_cast<ItemKind>(reader.ReadInt<uint8_t>());
+      const double time = reader.ReadDouble();
+      auto name = reader.ReadString();
+      if (kind == ItemKind::WAIT) {
+        info.items.push_back(WaitActivity{"Wait", time, move(name)});
+      } else if (kind == ItemKind::BUS) {
+        info.items.push_back(BusActivity{"Bus", time, move(name), reader.ReadInt<uint32_t>()});
+      } else {
+        throw invalid_argument("Unknown route item kind");
+      }
+    }
+  }
+  return info;
+}
+
+template <typename Info, typename ReadBody>
+void ReadSection(Reader& section, uint32_t count, vector<Info>& records, ReadBody read_body) {
+  // Every record is at least its u32 length
+  section.CheckCount(count, sizeof(uint32_t));
+  records.reserve(records.size() + count);
+  for (uint32_t i = 0; i < count; ++i) {
+    Reader record = section.ReadRecord();
+    records.push_back(read_body(record));
+  }
+}
+
+}
+
+string EncodeResults(const vector<StopInfo>& stop_info, const vector<BusInfo>& bus_info, const vector<RouteInfo>& route_data) {
+  string output;
+  Writer writer{output};
+  output.append(MAGIC);
+  writer.WriteInt(VERSION);
+  writer.WriteInt(uint16_t{3});
+
+  WriteSection(writer, Section::STOP_INFO, stop_info, [&writer](const StopInfo& info) {
+    writer.WriteInt(static_cast<uint32_t>(info.buses.size()));
+    for (const auto& bus : info.buses) {
+      writer.WriteString(bus);
+    }
+  });
+
+  WriteSection(writer, Section::BUS_INFO, bus_info, [&writer](const BusInfo& info) {
+    writer.WriteInt(static_cast<uint64_t>(info.route_length));
+    writer.WriteDouble(info.curvature);
+    writer.WriteInt(static_cast<uint64_t>(info.stop_count));
+    writer.WriteInt(static_cast<uint64_t>(info.unique_stop_count));
+  });
+
+  WriteSection(writer, Section::ROUTE_INFO, route_data, [&writer](const RouteInfo& info) {
+    writer.WriteDouble(info.total_time);
+    writer.WriteInt(static_cast<uint32_t>(info.items.size()));
+    for (const auto& item : info.items) {
+      if (holds_alternative<WaitActivity>(item)) {
+        const auto& wait = get<WaitActivity>(item);
+        writer.WriteInt(static_cast<uint8_t>(ItemKind::WAIT));
+        writer.WriteDouble(wait.time);
+        writer.WriteString(wait.stop_name);
+      } else {
+        const auto& bus = get<BusActivity>(item);
+        writer.WriteInt(static_cast<uint8_t>(ItemKind::BUS));
+        writer.WriteDouble(bus.time);
+        writer.WriteString(bus.bus);
+        writer.WriteInt(static_cast<uint32_t>(bus.span_count));
+      }
+    }
+  });
+
+  return output;
+}
+
+void PrintResults(const vector<StopInfo>& stop_info, const vector<BusInfo>& bus_info, const vector<RouteInfo>& route_data,
+                  ostream& output) {
+  const auto encoded = EncodeResults(stop_info, bus_info, route_data);
+  output.write(encoded.data(), static_cast<streamsize>(encoded.size()));
+}
+
+Results DecodeResults(string_view data) {
+  Reader reader{data};
+  if (reader.Take(MAGIC.size()) != MAGIC) {
+    throw invalid_argument("Not a binary results stream");
+  }
+  if (const auto version = reader.ReadInt<uint16_t>(); version != VERSION) {
+    throw invalid_argument("Unsupported binary results version " + to_string(version));
+  }
+
+  Results results;
+  const auto section_count = reader.ReadInt<uint16_t>();
+  for (uint16_t i = 0; i < section_count; ++i) {
+    const auto kind = static_cast<Section>(reader.ReadInt<uint8_t>());
+    const auto count = reader.ReadInt<uint32_t>();
+    Reader section{reader.Take(static_cast<size_t>(reader.ReadInt<uint64_t>()))};
+    if (kind == Section::STOP_INFO) {
+      ReadSection(section, count, results.stop_info, ReadStopInfo);
+    } else if (kind == Section::BUS_INFO) {
+      ReadSection(section, count, results.bus_info, ReadBusInfo);
+    } else if (kind == Section::ROUTE_INFO) {
+      ReadSection(section, count, results.route_data, ReadRouteInfo);
+    }
+  }
+  return results;
+}
+
+Results ReadResults(istream& input) {
+  const string data{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+  return DecodeResults(data);
+}
+
+} // namespace BinaryArgs
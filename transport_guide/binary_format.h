@@ -0,0 +1,40 @@
+#pragma once
+
+#include "transport_manager_command.h"
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Compact binary encoding of Stop, Bus and Route responses.
+//
+// All integers and doubles are little-endian. The stream starts with the
+// header "TGBR", u16 version, u16 section count. Every section is
+// u8 kind, u32 record count, u64 byte size, followed by its records, so a
+// reader skips sections it does not know. Every record is prefixed with its
+// u32 byte size and starts with u64 request_id, u8 has_error and, on error,
+// the message. Strings are u32 length and bytes.
+//
+//   Stop:  u32 bus count, bus names
+//   Bus:   u64 route_length, f64 curvature, u64 stop_count, u64 unique_stop_count
+//   Route: f64 total_time, u32 item count, items of
+//          u8 kind (0 wait, 1 bus), f64 time, name, u32 span_count for buses
+namespace BinaryArgs {
+
+struct Results {
+  std::vector<StopInfo> stop_info;
+  std::vector<BusInfo> bus_info;
+  std::vector<RouteInfo> route_data;
+};
+
+std::string EncodeResults(const std::vector<StopInfo>& stop_info, const std::vector<BusInfo>& bus_info,
+                          const std::vector<RouteInfo>& route_data);
+void PrintResults(const std::vector<StopInfo>& stop_info, const std::vector<BusInfo>& bus_info,
+                  const std::vector<RouteInfo>& route_data, std::ostream& output);
+
+// Throws invalid_argument on a malformed or truncated stream
+Results DecodeResults(std::string_view data);
+Results ReadResults(std::istream& input);
+
+} // namespace BinaryArgs
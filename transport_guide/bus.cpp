@@ -1,4 +1,5 @@
 #include "bus.h"
+#include "memory_usage.h"
 #include "stop_manager.h"
 
 #include <algorithm>
@@ -7,25 +8,41 @@
 #include <stdexcept>
 #include <utility>
 #include <sstream>
-#include <unordered_set>
 #include <vector>
 
 using namespace std;
 
-BusRoute::BusRoute(RouteNumber bus_no, vector<string> stops)
+BusRoute::BusRoute(RouteNumber bus_no, vector<StopId> stops, bool roundtrip)
   : number_(move(bus_no))
   , stops_(move(stops))
-  , stop_names_(begin(stops_), end(stops_))
+  , roundtrip_(roundtrip)
 {
+  vector<StopId> unique_stops{stops_};
+  sort(begin(unique_stops), end(unique_stops));
+  unique_stop_count_ = unique(begin(unique_stops), end(unique_stops)) - begin(unique_stops);
 }
 
-BusRoute BusRoute::CreateRawBusRoute(RouteNumber bus_no,
-                                     const std::vector<std::string>& stops) {
-  vector<string> cyclic_route{begin(stops), end(stops)};
-  cyclic_route.insert(end(cyclic_route), next(rbegin(stops)), rend(stops));
-  return {move(bus_no), move(cyclic_route)};
+bool BusRoute::ContainsStop(StopId stop_id) const {
+  return find(begin(stops_), end(stops_), stop_id) != end(stops_);
 }
 
-BusRoute BusRoute::CreateCyclicBusRoute(RouteNumber bus_no, const std::vector<std::string>& stops) {
-  return {move(bus_no), stops};
+size_t BusRoute::HeapBytes() const {
+  return Memory::HeapBytes(number_) + Memory::HeapBytes(stops_) + Memory::HeapBytes(intervals_);
+}
+
+void BusRoute::SetIntervals(vector<BusInterval> intervals) {
+  for (const auto& interval : intervals) {
+    if (interval.interval <= 0 || interval.end < interval.start) {
+      throw invalid_argument("Bad interval for bus " + number_);
+    }
+  }
+  intervals_ = move(intervals);
+}
+
+BusRoute BusRoute::CreateRawBusRoute(RouteNumber bus_no, vector<StopId> stops) {
+  return {move(bus_no), move(stops), false};
+}
+
+BusRoute BusRoute::CreateCyclicBusRoute(RouteNumber bus_no, vector<StopId> stops) {
+  return {move(bus_no), move(stops), true};
 }
@@ -3,33 +3,96 @@
 #include "stop_manager.h"
 
 #include <cstddef>
+#include <iterator>
 #include <optional>
 #include <vector>
 #include <string>
-#include <unordered_set>
 #include <memory>
 #include <utility>
 
+// Departures from the first stop every interval minutes during [start, end)
+struct BusInterval {
+  double start;
+  double end;
+  double interval;
+};
+
 class BusRoute {
 public:
   using RouteNumber = std::string;
 
-  BusRoute(RouteNumber bus_no, std::vector<std::string> stop_names);
+  // Stop sequence of a route as it is driven. A linear route keeps only its
+  // outbound stops; the way back is produced by mirroring the indices.
+  class StopSequence {
+  public:
+    class Iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = StopId;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const StopId*;
+      using reference = StopId;
+
+      Iterator(const std::vector<StopId>* stops, size_t size, size_t pos) : stops_(stops), size_(size), pos_(pos) {}
+
+      StopId operator*() const { return At(*stops_, size_, pos_); }
+      Iterator& operator++() { ++pos_; return *this; }
+      Iterator operator++(int) { auto it = *this; ++pos_; return it; }
+      bool operator==(const Iterator& other) const { return pos_ == other.pos_; }
+      bool operator!=(const Iterator& other) const { return pos_ != other.pos_; }
+
+    private:
+      const std::vector<StopId>* stops_;
+      size_t size_;
+      size_t pos_;
+    };
+
+    StopSequence(const std::vector<StopId>& stops, bool roundtrip) : stops_(&stops), roundtrip_(roundtrip) {}
+
+    size_t size() const {
+      if (roundtrip_ || stops_->empty()) {
+        return stops_->size();
+      }
+      return 2 * stops_->size() - 1;
+    }
+    bool empty() const { return stops_->empty(); }
+    StopId operator[](size_t pos) const { return At(*stops_, size(), pos); }
+
+    Iterator begin() const { return {stops_, size(), 0}; }
+    Iterator end() const { return {stops_, size(), size()}; }
+
+  private:
+    const std::vector<StopId>* stops_;
+    bool roundtrip_;
+
+    static StopId At(const std::vector<StopId>& stops, size_t size, size_t pos) {
+      return pos < stops.size() ? stops[pos] : stops[size - 1 - pos];
+    }
+  };
+
+  BusRoute(RouteNumber bus_no, std::vector<StopId> stops, bool roundtrip);
   BusRoute() = default;
 
   RouteNumber Number() const { return number_; }
-  const auto& Stops() const { return stops_; }
-  size_t UniqueStopNumber() const { return stop_names_.size(); }
+  StopSequence Stops() const { return {stops_, roundtrip_}; }
+  bool IsRoundtrip() const { return roundtrip_; }
+  size_t UniqueStopNumber() const { return unique_stop_count_; }
   std::optional<std::pair<double, double>> RouteLength() { return route_length_; }
-  bool ContainsStop(const std::string& stop_name) const { return stop_names_.count(stop_name); }
+  bool ContainsStop(StopId stop_id) const;
+  size_t HeapBytes() const;
+  // Empty when the bus has no timetable of its own
+  const std::vector<BusInterval>& Intervals() const { return intervals_; }
 
   void SetRouteLength(size_t road_length, double direct_length) { route_length_ = {road_length, direct_length}; }
+  void SetIntervals(std::vector<BusInterval> intervals);
 
-  static BusRoute CreateRawBusRoute(RouteNumber bus_no, const std::vector<std::string>& stop_names);
-  static BusRoute CreateCyclicBusRoute(RouteNumber bus_no, const std::vector<std::string>& stop_names);
+  static BusRoute CreateRawBusRoute(RouteNumber bus_no, std::vector<StopId> stops);
+  static BusRoute CreateCyclicBusRoute(RouteNumber bus_no, std::vector<StopId> stops);
 private:
   RouteNumber number_;
-  std::vector<std::string> stops_;
-  std::unordered_set<std::string> stop_names_;
+  std::vector<StopId> stops_;
+  bool roundtrip_{true};
+  size_t unique_stop_count_{0};
+  std::vector<BusInterval> intervals_;
   std::optional<std::pair<size_t, double>> route_length_;
 };
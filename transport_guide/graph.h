@@ -1,7 +1,11 @@
 #pragma once
 
+#include "memory_usage.h"
+
 #include <cstdlib>
 #include <deque>
+#include <limits>
+#include <stdexcept>
 #include <vector>
 
 template <typename It>
@@ -23,63 +27,77 @@ namespace Graph {
   using VertexId = size_t;
   using EdgeId = size_t;
 
-  template <typename Weight>
+  // Id is the integer type of vertex and edge ids: a 32-bit Id together with
+  // a float Weight halves the size of edges and router tables
+  template <typename Weight, typename Id = size_t>
   struct Edge {
-    VertexId from;
-    VertexId to;
+    Id from;
+    Id to;
     Weight weight;
   };
 
-  template <typename Weight>
+  template <typename Weight, typename Id = size_t>
   class DirectedWeightedGraph {
+  public:
+    using VertexId = Id;
+    using EdgeId = Id;
+
   private:
     using IncidenceList = std::vector<EdgeId>;
     using IncidentEdgesRange = Range<typename IncidenceList::const_iterator>;
 
   public:
     DirectedWeightedGraph(size_t vertex_count);
-    EdgeId AddEdge(const Edge<Weight>& edge);
+    EdgeId AddEdge(const Edge<Weight, Id>& edge);
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
-    const Edge<Weight>& GetEdge(EdgeId edge_id) const;
+    const Edge<Weight, Id>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+    size_t HeapBytes() const { return Memory::HeapBytes(edges_) + Memory::HeapBytes(incidence_lists_); }
 
   private:
-    std::vector<Edge<Weight>> edges_;
+    std::vector<Edge<Weight, Id>> edges_;
     std::vector<IncidenceList> incidence_lists_;
   };
 
 
-  template <typename Weight>
-  DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count) : incidence_lists_(vertex_count) {}
+  template <typename Weight, typename Id>
+  DirectedWeightedGraph<Weight, Id>::DirectedWeightedGraph(size_t vertex_count) : incidence_lists_(vertex_count) {
+    if (vertex_count > std::numeric_limits<Id>::max()) {
+      throw std::length_error("vertex count does not fit graph id type");
+    }
+  }
 
-  template <typename Weight>
-  EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+  template <typename Weight, typename Id>
+  Id DirectedWeightedGraph<Weight, Id>::AddEdge(const Edge<Weight, Id>& edge) {
+    if (edges_.size() == std::numeric_limits<Id>::max()) {
+      throw std::length_error("edge count does not fit graph id type");
+    }
     edges_.push_back(edge);
     const EdgeId id = edges_.size() - 1;
     incidence_lists_[edge.from].push_back(id);
     return id;
   }
 
-  template <typename Weight>
-  size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
+  template <typename Weight, typename Id>
+  size_t DirectedWeightedGraph<Weight, Id>::GetVertexCount() const {
     return incidence_lists_.size();
   }
 
-  template <typename Weight>
-  size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
+  template <typename Weight, typename Id>
+  size_t DirectedWeightedGraph<Weight, Id>::GetEdgeCount() const {
     return edges_.size();
   }
 
-  template <typename Weight>
-  const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
+  template <typename Weight, typename Id>
+  const Edge<Weight, Id>& DirectedWeightedGraph<Weight, Id>::GetEdge(EdgeId edge_id) const {
     return edges_[edge_id];
   }
 
-  template <typename Weight>
-  typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
-  DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
+  template <typename Weight, typename Id>
+  typename DirectedWeightedGraph<Weight, Id>::IncidentEdgesRange
+  DirectedWeightedGraph<Weight, Id>::GetIncidentEdges(VertexId vertex) const {
     const auto& edges = incidence_lists_[vertex];
     return {std::begin(edges), std::end(edges)};
   }
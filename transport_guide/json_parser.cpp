@@ -2,6 +2,8 @@
 
 #include "json.h"
 #include "transport_manager_command.h"
+#include <cmath>
+#include <limits>
 #include <variant>
 
 using namespace std;
@@ -9,6 +11,10 @@ using namespace Json;
 
 namespace JsonArgs {
 
+double ReadNumber(const Node& node) {
+  return holds_alternative<int>(node) ? node.AsInt() : node.AsDouble();
+}
+
 unique_ptr<InCommand> ReadInputCommand(const Node& node) {
   auto command = node.AsMap();
   auto type = command["type"].AsString();
@@ -38,7 +44,19 @@ unique_ptr<InCommand> ReadInputCommand(const Node& node) {
               back_inserter(stops),
               [](const Node& n) { return n.AsString(); });
     auto is_roundtrip = command["is_roundtrip"].AsBool();
-    return make_unique<NewBusCommand>(route_number, stops, is_roundtrip);
+
+    vector<BusInterval> intervals;
+    if (command.count("intervals")) {
+      for (const auto& interval_node : command["intervals"].AsArray()) {
+        auto interval = interval_node.AsMap();
+        intervals.push_back(BusInterval{
+          .start = ReadNumber(interval["from"]),
+          .end = ReadNumber(interval["to"]),
+          .interval = ReadNumber(interval["interval"]),
+        });
+      }
+    }
+    return make_unique<NewBusCommand>(route_number, stops, is_roundtrip, move(intervals));
   } else {
     throw std::invalid_argument("Unsupported command");
   }
@@ -58,6 +76,43 @@ unique_ptr<OutCommand> ReadOutputCommand(const Node& node) {
     auto from = command["from"].AsString();
     auto to = command["to"].AsString();
     return make_unique<RouteCommand>(from, to, request_id);
+  } else if (type == "ParetoRoute") {
+    auto from = command["from"].AsString();
+    auto to = command["to"].AsString();
+    size_t max_routes = command.count("max_routes") ? static_cast<size_t>(command["max_routes"].AsInt())
+                                                    : ParetoRouteCommand::DEFAULT_MAX_ROUTES;
+    return make_unique<ParetoRouteCommand>(from, to, max_routes, request_id);
+  } else if (type == "RouteMatrix") {
+    auto read_stops = [](const vector<Node>& stop_nodes) {
+      vector<string> stops;
+      transform(begin(stop_nodes), end(stop_nodes),
+                back_inserter(stops),
+                [](const Node& n) { return n.AsString(); });
+      return stops;
+    };
+    return make_unique<RouteMatrixCommand>(read_stops(command["from"].AsArray()), read_stops(command["to"].AsArray()), request_id);
+  } else if (type == "Isochrone") {
+    auto from = command["from"].AsString();
+    const auto& max_time_node = command["max_time"];
+    double max_time = holds_alternative<int>(max_time_node) ? max_time_node.AsInt() : max_time_node.AsDouble();
+    return make_unique<IsochroneCommand>(from, max_time, request_id);
+  } else if (type == "NearestStops") {
+    auto count = static_cast<size_t>(command["count"].AsInt());
+    return make_unique<NearestStopsCommand>(ReadNumber(command["latitude"]), ReadNumber(command["longitude"]), count, request_id);
+  } else if (type == "StopsInBox") {
+    return make_unique<StopsInBoxCommand>(ReadNumber(command["min_latitude"]), ReadNumber(command["min_longitude"]),
+                                          ReadNumber(command["max_latitude"]), ReadNumber(command["max_longitude"]), request_id);
+  } else if (type == "MemoryUsage") {
+    return make_unique<MemoryUsageCommand>(request_id);
+  } else if (type == "TimedRoute") {
+    auto from = command["from"].AsString();
+    auto to = command["to"].AsString();
+    return make_unique<TimedRouteCommand>(from, to, ReadNumber(command["departure_time"]), request_id);
+  } else if (type == "RouteFromPoint") {
+    auto to = command["to"].AsString();
+    size_t snap_count = command.count("snap_count") ? static_cast<size_t>(command["snap_count"].AsInt())
+                                                    : RouteFromPointCommand::DEFAULT_SNAP_COUNT;
+    return make_unique<RouteFromPointCommand>(ReadNumber(command["latitude"]), ReadNumber(command["longitude"]), to, snap_count, request_id);
   } else {
     throw std::invalid_argument("Unsupported command");
   }
@@ -88,7 +143,42 @@ TransportManagerCommands ReadCommands(std::istream& s) {
   return commands;
 }
 
-void PrintResults(const std::vector<StopInfo>& stop_info, const std::vector<BusInfo>& bus_info, const std::vector<RouteInfo>& route_data, std::ostream& output) {
+// Node holds int, larger byte counts fall back to double
+Node BytesToNode(size_t bytes) {
+  if (bytes <= static_cast<size_t>(numeric_limits<int>::max())) {
+    return Node(static_cast<int>(bytes));
+  }
+  return Node(static_cast<double>(bytes));
+}
+
+Node ActivityToNode(const variant<WaitActivity, BusActivity>& item) {
+  map<string, Node> activity_node;
+  if (holds_alternative<WaitActivity>(item)) {
+    const auto& wait_activity = get<WaitActivity>(item);
+    activity_node["type"] = wait_activity.type;
+    // Fixed waits are whole minutes, timetabled ones are not
+    if (wait_activity.time == floor(wait_activity.time)) {
+      activity_node["time"] = static_cast<int>(wait_activity.time);
+    } else {
+      activity_node["time"] = wait_activity.time;
+    }
+    activity_node["stop_name"] = wait_activity.stop_name;
+  }
+  else {
+    const auto& bus_activity = get<BusActivity>(item);
+    activity_node["type"] = bus_activity.type;
+    activity_node["time"] = static_cast<double>(bus_activity.time);
+    activity_node["bus"] = bus_activity.bus;
+    activity_node["span_count"] = static_cast<int>(bus_activity.span_count);
+  }
+  return activity_node;
+}
+
+void PrintResults(const std::vector<StopInfo>& stop_info, const std::vector<BusInfo>& bus_info, const std::vector<RouteInfo>& route_data,
+                  const std::vector<ParetoRouteInfo>& pareto_route_data, const std::vector<RouteMatrixInfo>& route_matrix_data,
+                  const std::vector<IsochroneInfo>& isochrone_data, const std::vector<NearestStopsInfo>& nearest_stops_data,
+                  const std::vector<StopsInBoxInfo>& stops_in_box_data, const std::vector<MemoryUsageInfo>& memory_usage_data,
+                  std::ostream& output) {
   vector<Node> result;
 
   for (const auto& bus : bus_info) {
@@ -138,21 +228,7 @@ void PrintResults(const std::vector<StopInfo>& stop_info, const std::vector<BusI
     else {
       vector<Node> items;
       for (const auto& item : route.items) {
-        map<string, Node> activity_node;
-        if (holds_alternative<WaitActivity>(item)) {
-          auto wait_activity = get<WaitActivity>(item);
-          activity_node["type"] = wait_activity.type;
-          activity_node["time"] = static_cast<int>(wait_activity.time);
-          activity_node["stop_name"] = wait_activity.stop_name;
-        }
-        else {
-          auto bus_activity = get<BusActivity>(item);
-          activity_node["type"] = bus_activity.type;
-          activity_node["time"] = static_cast<double>(bus_activity.time);
-          activity_node["bus"] = bus_activity.bus;
-          activity_node["span_count"] = static_cast<int>(bus_activity.span_count);
-        }
-        items.push_back(activity_node);
+        items.push_back(ActivityToNode(item));
       }
       route_dict["items"] = items;
       route_dict["total_time"] = route.total_time;
@@ -160,6 +236,130 @@ void PrintResults(const std::vector<StopInfo>& stop_info, const std::vector<BusI
     result.push_back(Node(move(route_dict)));
   }
 
+  for (const auto& pareto_route : pareto_route_data) {
+    map<string, Node> pareto_route_dict = {
+      {"request_id", Node(static_cast<int>(pareto_route.request_id))},
+    };
+
+    if (pareto_route.error_message.has_value()) {
+      pareto_route_dict["error_message"] = Node(pareto_route.error_message.value());
+    }
+    else {
+      vector<Node> routes;
+      for (const auto& route : pareto_route.routes) {
+        vector<Node> items;
+        for (const auto& item : route.items) {
+          items.push_back(ActivityToNode(item));
+        }
+        routes.push_back(map<string, Node>{
+          {"items", items},
+          {"total_time", route.total_time},
+          {"transfer_count", static_cast<int>(route.transfer_count)},
+        });
+      }
+      pareto_route_dict["routes"] = routes;
+    }
+    result.push_back(Node(move(pareto_route_dict)));
+  }
+
+  for (const auto& route_matrix : route_matrix_data) {
+    map<string, Node> route_matrix_dict = {
+      {"request_id", Node(static_cast<int>(route_matrix.request_id))},
+    };
+
+    if (route_matrix.error_message.has_value()) {
+      route_matrix_dict["error_message"] = Node(route_matrix.error_message.value());
+    }
+    else {
+      // unreachable pairs are reported as -1
+      vector<Node> rows;
+      const size_t column_count = max<size_t>(1, route_matrix.column_count);
+      for (size_t row_begin = 0; row_begin < route_matrix.total_times.size(); row_begin += column_count) {
+        vector<Node> row;
+        row.reserve(column_count);
+        for (size_t i = row_begin; i < row_begin + column_count; ++i) {
+          const auto& total_time = route_matrix.total_times[i];
+          row.push_back(total_time ? Node(*total_time) : Node(-1));
+        }
+        rows.push_back(move(row));
+      }
+      route_matrix_dict["total_times"] = move(rows);
+    }
+    result.push_back(Node(move(route_matrix_dict)));
+  }
+
+  for (const auto& isochrone : isochrone_data) {
+    map<string, Node> isochrone_dict = {
+      {"request_id", Node(static_cast<int>(isochrone.request_id))},
+    };
+
+    if (isochrone.error_message.has_value()) {
+      isochrone_dict["error_message"] = Node(isochrone.error_message.value());
+    }
+    else {
+      vector<Node> stops;
+      for (const auto& stop : isochrone.stops) {
+        stops.push_back(map<string, Node>{
+          {"stop_name", stop.stop_name},
+          {"total_time", stop.total_time},
+        });
+      }
+      isochrone_dict["stops"] = move(stops);
+    }
+    result.push_back(Node(move(isochrone_dict)));
+  }
+
+  for (const auto& nearest_stops : nearest_stops_data) {
+    map<string, Node> nearest_stops_dict = {
+      {"request_id", Node(static_cast<int>(nearest_stops.request_id))},
+    };
+
+    if (nearest_stops.error_message.has_value()) {
+      nearest_stops_dict["error_message"] = Node(nearest_stops.error_message.value());
+    }
+    else {
+      vector<Node> stops;
+      for (const auto& stop : nearest_stops.stops) {
+        stops.push_back(map<string, Node>{
+          {"stop_name", stop.stop_name},
+          {"distance", stop.distance},
+        });
+      }
+      nearest_stops_dict["stops"] = move(stops);
+    }
+    result.push_back(Node(move(nearest_stops_dict)));
+  }
+
+  for (const auto& stops_in_box : stops_in_box_data) {
+    map<string, Node> stops_in_box_dict = {
+      {"request_id", Node(static_cast<int>(stops_in_box.request_id))},
+    };
+
+    if (stops_in_box.error_message.has_value()) {
+      stops_in_box_dict["error_message"] = Node(stops_in_box.error_message.value());
+    }
+    else {
+      vector<Node> stops;
+      transform(begin(stops_in_box.stops), end(stops_in_box.stops),
+                back_inserter(stops),
+                [](const string& stop_name) { return Node(stop_name); });
+      stops_in_box_dict["stops"] = move(stops);
+    }
+    result.push_back(Node(move(stops_in_box_dict)));
+  }
+
+  for (const auto& memory_usage : memory_usage_data) {
+    map<string, Node> components;
+    for (const auto& component : memory_usage.components) {
+      components[component.name] = BytesToNode(component.bytes);
+    }
+    result.push_back(map<string, Node>{
+      {"request_id", Node(static_cast<int>(memory_usage.request_id))},
+      {"components", move(components)},
+      {"total_bytes", BytesToNode(memory_usage.total_bytes)},
+    });
+  }
+
   Node root{result};
   Document doc{root};
 
@@ -10,6 +10,10 @@
 namespace JsonArgs {
 
 TransportManagerCommands ReadCommands(std::istream& s);
-void PrintResults(const std::vector<StopInfo>& stop_info, const std::vector<BusInfo>& bus_info, const std::vector<RouteInfo>& route_data, std::ostream& output);
+void PrintResults(const std::vector<StopInfo>& stop_info, const std::vector<BusInfo>& bus_info, const std::vector<RouteInfo>& route_data,
+                  const std::vector<ParetoRouteInfo>& pareto_route_data, const std::vector<RouteMatrixInfo>& route_matrix_data,
+                  const std::vector<IsochroneInfo>& isochrone_data, const std::vector<NearestStopsInfo>& nearest_stops_data,
+                  const std::vector<StopsInBoxInfo>& stops_in_box_data, const std::vector<MemoryUsageInfo>& memory_usage_data,
+                  std::ostream& output);
 
 } // namespace JsonArgs 
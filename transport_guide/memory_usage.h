@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Heap bytes owned by a value, not counting sizeof the value itself.
+// Container layouts follow libstdc++: short strings are stored inline and a
+// hash table allocates its bucket array plus one node per element holding
+// the next pointer, the cached hash and the element.
+namespace Memory {
+
+size_t HeapBytes(const std::string& value);
+template <typename T> size_t HeapBytes(const std::vector<T>& values);
+template <typename T> size_t HeapBytes(const std::optional<T>& value);
+template <typename T, typename U> size_t HeapBytes(const std::pair<T, U>& value);
+template <typename K, typename V, typename H, typename E, typename A>
+size_t HeapBytes(const std::unordered_map<K, V, H, E, A>& values);
+template <typename T> size_t HeapBytes(const T& value);
+
+namespace Detail {
+
+template <typename T, typename = void>
+struct HasHeapBytes : std::false_type {};
+
+template <typename T>
+struct HasHeapBytes<T, std::void_t<decltype(std::declval<const T&>().HeapBytes())>> : std::true_type {};
+
+template <typename T>
+constexpr bool OwnsNoHeap = std::is_trivially_copyable_v<T> && !HasHeapBytes<T>::value;
+
+}
+
+inline size_t HeapBytes(const std::string& value) {
+  static const size_t inline_capacity = std::string{}.capacity();
+  return value.capacity() > inline_capacity ? value.capacity() + 1 : 0;
+}
+
+template <typename T>
+size_t HeapBytes(const std::vector<T>& values) {
+  size_t bytes = values.capacity() * sizeof(T);
+  if constexpr (!Detail::OwnsNoHeap<T>) {
+    for (const auto& value : values) {
+      bytes += HeapBytes(value);
+    }
+  }
+  return bytes;
+}
+
+template <typename T>
+size_t HeapBytes(const std::optional<T>& value) {
+  return value ? HeapBytes(*value) : 0;
+}
+
+template <typename T, typename U>
+size_t HeapBytes(const std::pair<T, U>& value) {
+  return HeapBytes(value.first) + HeapBytes(value.second);
+}
+
+template <typename K, typename V, typename H, typename E, typename A>
+size_t HeapBytes(const std::unordered_map<K, V, H, E, A>& values) {
+  const size_t node_size = sizeof(void*) + sizeof(size_t) + sizeof(typename std::unordered_map<K, V, H, E, A>::value_type);
+  size_t bytes = values.bucket_count() * sizeof(void*) + values.size() * node_size;
+  if constexpr (!Detail::OwnsNoHeap<K> || !Detail::OwnsNoHeap<V>) {
+    for (const auto& [key, value] : values) {
+      bytes += HeapBytes(key) + HeapBytes(value);
+    }
+  }
+  return bytes;
+}
+
+template <typename T>
+size_t HeapBytes(const T& value) {
+  if constexpr (Detail::HasHeapBytes<T>::value) {
+    return value.HeapBytes();
+  } else {
+    static_assert(std::is_trivially_copyable_v<T>, "HeapBytes is not known for this type");
+    return 0;
+  }
+}
+
+// Bytes of a value including its own storage
+template <typename T>
+size_t TotalBytes(const T& value) {
+  return sizeof(T) + HeapBytes(value);
+}
+
+}
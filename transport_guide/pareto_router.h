@@ -0,0 +1,135 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <queue>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Graph {
+
+  // Bicriteria label-setting Dijkstra: minimizes the edge weight sum and the
+  // sum of per-edge integer costs (e.g. number of boardings) at the same time
+  // and returns the Pareto-optimal routes ordered by increasing weight.
+  template <typename Weight, typename Id = size_t>
+  class ParetoRouter {
+  private:
+    using Graph = DirectedWeightedGraph<Weight, Id>;
+
+  public:
+    using VertexId = Id;
+    using EdgeId = Id;
+
+    using Cost = uint32_t;
+
+    ParetoRouter(const Graph& graph, std::vector<Cost> edge_costs);
+
+    struct RouteInfo {
+      Weight weight;
+      Cost cost;
+      std::vector<EdgeId> edges;
+    };
+
+    std::vector<RouteInfo> BuildRoutes(VertexId from, VertexId to, size_t max_routes) const;
+    size_t HeapBytes() const { return Memory::HeapBytes(edge_costs_); }
+
+  private:
+    const Graph& graph_;
+    std::vector<Cost> edge_costs_;
+
+    static constexpr size_t NO_LABEL = std::numeric_limits<size_t>::max();
+
+    struct Label {
+      Weight weight;
+      Cost cost;
+      VertexId vertex;
+      EdgeId edge;
+      size_t prev_label;
+    };
+
+    struct QueueItem {
+      Weight weight;
+      Cost cost;
+      size_t label;
+
+      bool operator>(const QueueItem& other) const {
+        return std::tie(weight, cost) > std::tie(other.weight, other.cost);
+      }
+    };
+
+    std::vector<EdgeId> ExpandRoute(const std::vector<Label>& labels, size_t label_id) const;
+  };
+
+
+  template <typename Weight, typename Id>
+  ParetoRouter<Weight, Id>::ParetoRouter(const Graph& graph, std::vector<Cost> edge_costs)
+      : graph_(graph),
+        edge_costs_(std::move(edge_costs))
+  {
+    edge_costs_.resize(graph_.GetEdgeCount(), 0);
+  }
+
+  template <typename Weight, typename Id>
+  std::vector<typename ParetoRouter<Weight, Id>::RouteInfo>
+  ParetoRouter<Weight, Id>::BuildRoutes(VertexId from, VertexId to, size_t max_routes) const {
+    std::vector<RouteInfo> routes;
+    if (max_routes == 0) {
+      return routes;
+    }
+
+    // Labels leave the queue in (weight, cost) order, so a label is dominated
+    // iff some vertex label settled before it has a cost not greater than its own.
+    std::vector<Cost> min_settled_cost(graph_.GetVertexCount(), std::numeric_limits<Cost>::max());
+    std::vector<Label> labels;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+
+    labels.push_back(Label{0, 0, from, 0, NO_LABEL});
+    queue.push(QueueItem{0, 0, 0});
+
+    while (!queue.empty() && routes.size() < max_routes) {
+      const QueueItem item = queue.top();
+      queue.pop();
+
+      const Label label = labels[item.label];
+      if (label.cost >= min_settled_cost[label.vertex] || label.cost >= min_settled_cost[to]) {
+        continue;
+      }
+      min_settled_cost[label.vertex] = label.cost;
+
+      if (label.vertex == to) {
+        routes.push_back(RouteInfo{label.weight, label.cost, ExpandRoute(labels, item.label)});
+        continue;
+      }
+
+      for (const EdgeId edge_id : graph_.GetIncidentEdges(label.vertex)) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        const Cost cost = label.cost + edge_costs_[edge_id];
+        if (cost >= min_settled_cost[edge.to] || cost >= min_settled_cost[to]) {
+          continue;
+        }
+        const Weight weight = label.weight + edge.weight;
+        labels.push_back(Label{weight, cost, edge.to, edge_id, item.label});
+        queue.push(QueueItem{weight, cost, labels.size() - 1});
+      }
+    }
+
+    return routes;
+  }
+
+  template <typename Weight, typename Id>
+  std::vector<Id> ParetoRouter<Weight, Id>::ExpandRoute(const std::vector<Label>& labels, size_t label_id) const {
+    std::vector<Id> edges;
+    for (; labels[label_id].prev_label != NO_LABEL; label_id = labels[label_id].prev_label) {
+      edges.push_back(labels[label_id].edge);
+    }
+    std::reverse(std::begin(edges), std::end(edges));
+    return edges;
+  }
+
+}
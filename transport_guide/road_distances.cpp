@@ -0,0 +1,83 @@
+#include "road_distances.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+
+using namespace std;
+
+void RoadDistances::Add(StopId from, StopId to, unsigned int meters) {
+  if (frozen_) {
+    throw logic_error("road distances are already frozen");
+  }
+  records_.push_back({from, to, meters});
+}
+
+void RoadDistances::Freeze(size_t stop_count) {
+  // Replays the records in order: an explicit distance always overwrites,
+  // the implied reverse one only fills a missing or zero distance
+  struct Event {
+    StopId from;
+    StopId to;
+    uint32_t order;
+    bool implied;
+    unsigned int meters;
+  };
+
+  vector<Event> events;
+  events.reserve(2 * records_.size());
+  for (size_t i = 0; i < records_.size(); ++i) {
+    const auto& record = records_[i];
+    events.push_back({record.from, record.to, static_cast<uint32_t>(i), false, record.meters});
+    events.push_back({record.to, record.from, static_cast<uint32_t>(i), true, record.meters});
+  }
+  sort(begin(events), end(events), [](const Event& lhs, const Event& rhs) {
+    return tie(lhs.from, lhs.to, lhs.order, lhs.implied) < tie(rhs.from, rhs.to, rhs.order, rhs.implied);
+  });
+
+  offsets_.assign(stop_count + 1, 0);
+  neighbours_.clear();
+  for (auto it = begin(events); it != end(events); ) {
+    const auto pair_end = find_if(it, end(events), [it](const Event& event) {
+      return event.from != it->from || event.to != it->to;
+    });
+
+    unsigned int meters{0};
+    bool present{false};
+    for (; it != pair_end; ++it) {
+      if (!it->implied || !present || meters == 0) {
+        meters = it->meters;
+        present = true;
+      }
+    }
+
+    const auto& last = *prev(pair_end);
+    neighbours_.push_back({last.to, meters});
+    ++offsets_[last.from + 1];
+  }
+  for (size_t i = 0; i < stop_count; ++i) {
+    offsets_[i + 1] += offsets_[i];
+  }
+
+  records_.clear();
+  records_.shrink_to_fit();
+  frozen_ = true;
+}
+
+unsigned int RoadDistances::Get(StopId from, StopId to) const {
+  if (from + 1 >= offsets_.size()) {
+    return 0;
+  }
+  const auto row_begin = begin(neighbours_) + offsets_[from];
+  const auto row_end = begin(neighbours_) + offsets_[from + 1];
+  const auto it = lower_bound(row_begin, row_end, to, [](const Neighbour& neighbour, StopId stop) {
+    return neighbour.stop < stop;
+  });
+  return it != row_end && it->stop == to ? it->meters : 0;
+}
+
+size_t RoadDistances::HeapBytes() const {
+  return Memory::HeapBytes(records_) + Memory::HeapBytes(offsets_) + Memory::HeapBytes(neighbours_);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "stop_manager.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Road distances between stops. Distances are appended as raw records while
+// the base is being read and frozen once into a sorted CSR table of
+// (neighbour, meters) per stop, so lookups touch two flat arrays only.
+class RoadDistances {
+public:
+  // Distance from -> to; also implies to -> from unless that one is given explicitly
+  void Add(StopId from, StopId to, unsigned int meters);
+
+  void Freeze(size_t stop_count);
+  bool IsFrozen() const { return frozen_; }
+
+  // Requires Freeze; zero for unknown pairs
+  unsigned int Get(StopId from, StopId to) const;
+
+  size_t HeapBytes() const;
+
+private:
+  struct Record {
+    StopId from;
+    StopId to;
+    unsigned int meters;
+  };
+
+  struct Neighbour {
+    StopId stop;
+    unsigned int meters;
+  };
+
+  std::vector<Record> records_;
+  std::vector<uint32_t> offsets_;
+  std::vector<Neighbour> neighbours_;
+  bool frozen_{false};
+};
@@ -13,12 +13,15 @@
 
 namespace Graph {
 
-  template <typename Weight>
+  template <typename Weight, typename Id = size_t>
   class Router {
   private:
-    using Graph = DirectedWeightedGraph<Weight>;
+    using Graph = DirectedWeightedGraph<Weight, Id>;
 
   public:
+    using VertexId = Id;
+    using EdgeId = Id;
+
     Router(const Graph& graph);
 
     using RouteId = uint64_t;
@@ -30,8 +33,16 @@ namespace Graph {
     };
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    std::optional<Weight> GetRouteWeight(VertexId from, VertexId to) const;
+    // Edges of the route in order; unlike BuildRoute it keeps nothing in the
+    // router, so it may be called from several threads
+    std::optional<std::vector<EdgeId>> GetRouteEdges(VertexId from, VertexId to) const;
+    // Last edge of the route, nullopt if the route is empty or missing; the
+    // rest of the route is the route to the source of that edge
+    std::optional<EdgeId> GetLastRouteEdge(VertexId from, VertexId to) const;
     EdgeId GetRouteEdge(RouteId route_id, size_t edge_idx) const;
     void ReleaseRoute(RouteId route_id);
+    size_t HeapBytes() const { return Memory::HeapBytes(routes_internal_data_) + Memory::HeapBytes(expanded_routes_cache_); }
 
   private:
     const Graph& graph_;
@@ -91,8 +102,8 @@ namespace Graph {
   };
 
 
-  template <typename Weight>
-  Router<Weight>::Router(const Graph& graph)
+  template <typename Weight, typename Id>
+  Router<Weight, Id>::Router(const Graph& graph)
       : graph_(graph),
         routes_internal_data_(graph.GetVertexCount(), std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
   {
@@ -104,34 +115,59 @@ namespace Graph {
     }
   }
 
-  template <typename Weight>
-  std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from, VertexId to) const {
+  template <typename Weight, typename Id>
+  std::optional<typename Router<Weight, Id>::RouteInfo> Router<Weight, Id>::BuildRoute(VertexId from, VertexId to) const {
+    auto edges = GetRouteEdges(from, to);
+    if (!edges) {
+      return std::nullopt;
+    }
+    const Weight weight = routes_internal_data_[from][to]->weight;
+
+    const RouteId route_id = next_route_id_++;
+    const size_t route_edge_count = edges->size();
+    expanded_routes_cache_[route_id] = std::move(*edges);
+    return RouteInfo{route_id, weight, route_edge_count};
+  }
+
+  template <typename Weight, typename Id>
+  std::optional<Weight> Router<Weight, Id>::GetRouteWeight(VertexId from, VertexId to) const {
+    if (const auto& route_internal_data = routes_internal_data_[from][to]) {
+      return route_internal_data->weight;
+    }
+    return std::nullopt;
+  }
+
+  template <typename Weight, typename Id>
+  std::optional<Id> Router<Weight, Id>::GetLastRouteEdge(VertexId from, VertexId to) const {
+    if (const auto& route_internal_data = routes_internal_data_[from][to]) {
+      return route_internal_data->prev_edge;
+    }
+    return std::nullopt;
+  }
+
+  template <typename Weight, typename Id>
+  std::optional<std::vector<Id>> Router<Weight, Id>::GetRouteEdges(VertexId from, VertexId to) const {
     const auto& route_internal_data = routes_internal_data_[from][to];
     if (!route_internal_data) {
       return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
-    std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
+    std::vector<Id> edges;
+    for (std::optional<Id> edge_id = route_internal_data->prev_edge;
          edge_id;
          edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge) {
       edges.push_back(*edge_id);
     }
     std::reverse(std::begin(edges), std::end(edges));
-
-    const RouteId route_id = next_route_id_++;
-    const size_t route_edge_count = edges.size();
-    expanded_routes_cache_[route_id] = std::move(edges);
-    return RouteInfo{route_id, weight, route_edge_count};
+    return edges;
   }
 
-  template <typename Weight>
-  EdgeId Router<Weight>::GetRouteEdge(RouteId route_id, size_t edge_idx) const {
+  template <typename Weight, typename Id>
+  Id Router<Weight, Id>::GetRouteEdge(RouteId route_id, size_t edge_idx) const {
     return expanded_routes_cache_.at(route_id)[edge_idx];
   }
 
-  template <typename Weight>
-  void Router<Weight>::ReleaseRoute(RouteId route_id) {
+  template <typename Weight, typename Id>
+  void Router<Weight, Id>::ReleaseRoute(RouteId route_id) {
     expanded_routes_cache_.erase(route_id);
   }
 
@@ -0,0 +1,164 @@
+#include "spatial_index.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+const double PI = 3.1415926535;
+const double ONE_DEG = PI / 180;
+// Bounds are computed a bit differently from Coordinates::Distance, keep them safely below it
+const double BOUND_SLACK = 1 - 1e-6;
+
+long double Axis(const Coordinates& coordinates, size_t depth) {
+  return depth % 2 == 0 ? coordinates.latitude : coordinates.longitude;
+}
+
+array<double, 3> ToUnitVector(const Coordinates& coordinates) {
+  const double latitude = static_cast<double>(coordinates.latitude) * ONE_DEG;
+  const double longitude = static_cast<double>(coordinates.longitude) * ONE_DEG;
+  return {cos(latitude) * cos(longitude), cos(latitude) * sin(longitude), sin(latitude)};
+}
+
+double SquaredChord(const array<double, 3>& lhs, const array<double, 3>& rhs) {
+  const double dx = lhs[0] - rhs[0];
+  const double dy = lhs[1] - rhs[1];
+  const double dz = lhs[2] - rhs[2];
+  return dx * dx + dy * dy + dz * dz;
+}
+
+// Squared chord of a central angle
+double AngleToSquaredChord(double angle) {
+  const double chord = 2 * sin(angle / 2);
+  return chord * chord;
+}
+
+}
+
+SpatialIndex::SpatialIndex(vector<Point> points)
+  : points_(move(points))
+{
+  Build(0, points_.size(), 0);
+  units_.reserve(points_.size());
+  for (const auto& point : points_) {
+    units_.push_back(ToUnitVector(point.coordinates));
+  }
+}
+
+void SpatialIndex::Build(size_t begin, size_t end, size_t depth) {
+  if (end - begin <= 1) {
+    return;
+  }
+  const size_t middle = begin + (end - begin) / 2;
+  nth_element(std::begin(points_) + begin, std::begin(points_) + middle, std::begin(points_) + end,
+              [depth](const Point& lhs, const Point& rhs) {
+                return Axis(lhs.coordinates, depth) < Axis(rhs.coordinates, depth);
+              });
+  Build(begin, middle, depth + 1);
+  Build(middle + 1, end, depth + 1);
+}
+
+vector<SpatialIndex::Neighbour> SpatialIndex::FindNearest(Coordinates point, size_t count) const {
+  vector<Neighbour> result;
+  if (count == 0 || points_.empty()) {
+    return result;
+  }
+
+  const Query query{point, ToUnitVector(point), cos(static_cast<double>(point.latitude) * ONE_DEG)};
+  vector<Candidate> heap;
+  heap.reserve(min(count, points_.size()) + 1);
+  FindNearest(0, points_.size(), 0, query, count, heap);
+
+  result.reserve(heap.size());
+  for (const auto& candidate : heap) {
+    const auto& found = points_[candidate.index];
+    result.push_back({found.id, static_cast<double>(Coordinates::Distance(point, found.coordinates))});
+  }
+  sort(std::begin(result), std::end(result), [](const Neighbour& lhs, const Neighbour& rhs) {
+    return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.id < rhs.id);
+  });
+  return result;
+}
+
+void SpatialIndex::FindNearest(size_t begin, size_t end, size_t depth, const Query& query, size_t count, vector<Candidate>& heap) const {
+  if (begin >= end) {
+    return;
+  }
+  const size_t middle = begin + (end - begin) / 2;
+  auto farther = [](const Candidate& lhs, const Candidate& rhs) { return lhs.chord < rhs.chord; };
+
+  const Candidate candidate{middle, SquaredChord(query.unit, units_[middle])};
+  if (heap.size() < count || candidate.chord < heap.front().chord) {
+    heap.push_back(candidate);
+    push_heap(std::begin(heap), std::end(heap), farther);
+    if (heap.size() > count) {
+      pop_heap(std::begin(heap), std::end(heap), farther);
+      heap.pop_back();
+    }
+  }
+
+  const long double split = Axis(points_[middle].coordinates, depth);
+  const bool left_first = Axis(query.point, depth) < split;
+  const pair<size_t, size_t> near_side = left_first ? pair{begin, middle} : pair{middle + 1, end};
+  const pair<size_t, size_t> far_side = left_first ? pair{middle + 1, end} : pair{begin, middle};
+
+  FindNearest(near_side.first, near_side.second, depth + 1, query, count, heap);
+  if (far_side.first >= far_side.second) {
+    return;
+  }
+  if (heap.size() < count) {
+    FindNearest(far_side.first, far_side.second, depth + 1, query, count, heap);
+    return;
+  }
+
+  // Lower bound of the angle between the query and any point on the other
+  // side of the splitting parallel or meridian. Longitudes past the split
+  // are also reached the other way round, across the ±180° seam
+  const long double query_axis = Axis(query.point, depth);
+  long double delta_degrees = abs(query_axis - split);
+  if (depth % 2 == 1) {
+    delta_degrees = min(delta_degrees, left_first ? 180 + query_axis : 180 - query_axis);
+  }
+  const double delta = static_cast<double>(delta_degrees) * ONE_DEG;
+  const double angle = depth % 2 == 0 ? delta : asin(query.cos_latitude * sin(min(delta, PI / 2)));
+  if (AngleToSquaredChord(angle * BOUND_SLACK) <= heap.front().chord) {
+    FindNearest(far_side.first, far_side.second, depth + 1, query, count, heap);
+  }
+}
+
+vector<StopId> SpatialIndex::FindInBox(Coordinates min_corner, Coordinates max_corner) const {
+  vector<StopId> result;
+  FindInBox(0, points_.size(), 0, min_corner, max_corner, result);
+  return result;
+}
+
+void SpatialIndex::FindInBox(size_t begin, size_t end, size_t depth, Coordinates min_corner, Coordinates max_corner, vector<StopId>& result) const {
+  if (begin >= end) {
+    return;
+  }
+  const size_t middle = begin + (end - begin) / 2;
+  const auto& root = points_[middle];
+  const auto& coordinates = root.coordinates;
+
+  if (min_corner.latitude <= coordinates.latitude && coordinates.latitude <= max_corner.latitude &&
+      min_corner.longitude <= coordinates.longitude && coordinates.longitude <= max_corner.longitude) {
+    result.push_back(root.id);
+  }
+
+  const long double split = Axis(coordinates, depth);
+  if (Axis(min_corner, depth) <= split) {
+    FindInBox(begin, middle, depth + 1, min_corner, max_corner, result);
+  }
+  if (split <= Axis(max_corner, depth)) {
+    FindInBox(middle + 1, end, depth + 1, min_corner, max_corner, result);
+  }
+}
+
+size_t SpatialIndex::HeapBytes() const {
+  return Memory::HeapBytes(points_) + Memory::HeapBytes(units_);
+}
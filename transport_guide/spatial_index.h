@@ -0,0 +1,57 @@
+#pragma once
+
+#include "stop_manager.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Static k-d tree over stop coordinates, alternately split by latitude and
+// longitude and stored implicitly in one array: the median of every range
+// is its subtree root. Distances are great-circle ones as in Coordinates, but
+// the search compares squared chord lengths between unit vectors and only
+// converts the final candidates.
+class SpatialIndex {
+public:
+  struct Point {
+    StopId id;
+    Coordinates coordinates;
+  };
+
+  struct Neighbour {
+    StopId id;
+    double distance;
+  };
+
+  SpatialIndex() = default;
+  explicit SpatialIndex(std::vector<Point> points);
+
+  size_t Size() const { return points_.size(); }
+  size_t HeapBytes() const;
+
+  // Up to count stops closest to the point, nearest first
+  std::vector<Neighbour> FindNearest(Coordinates point, size_t count) const;
+  // Stops with min_corner <= coordinates <= max_corner, in no particular order
+  std::vector<StopId> FindInBox(Coordinates min_corner, Coordinates max_corner) const;
+
+private:
+  using UnitVector = std::array<double, 3>;
+
+  struct Query {
+    Coordinates point;
+    UnitVector unit;
+    double cos_latitude;
+  };
+
+  struct Candidate {
+    size_t index;
+    double chord;
+  };
+
+  std::vector<Point> points_;
+  std::vector<UnitVector> units_;
+
+  void Build(size_t begin, size_t end, size_t depth);
+  void FindNearest(size_t begin, size_t end, size_t depth, const Query& query, size_t count, std::vector<Candidate>& heap) const;
+  void FindInBox(size_t begin, size_t end, size_t depth, Coordinates min_corner, Coordinates max_corner, std::vector<StopId>& result) const;
+};
@@ -1,4 +1,5 @@
 #include "stop_manager.h"
+#include "memory_usage.h"
 
 #include <cmath>
 #include <utility>
@@ -15,6 +16,10 @@ Stop::Stop(string name, Coordinates coordinates)
 {
 }
 
+size_t Stop::HeapBytes() const {
+  return Memory::HeapBytes(name_);
+}
+
 long double Coordinates::Distance(const Coordinates& lhs, const Coordinates& rhs) {
   auto to_radians = [](long double degrees) -> long double { return Coordinates::ONE_DEG * degrees; };
 
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <string_view>
 
+using StopId = uint32_t;
+
 struct Coordinates {
 public:
   long double latitude;
@@ -23,6 +27,7 @@ public:
   std::string Name() const { return name_; }
   Coordinates StopCoordinates() const { return coordinates_; }
   void SetCoordinates(Coordinates coordinates) { coordinates_ = coordinates; }
+  size_t HeapBytes() const;
 
 private:
   std::string name_;
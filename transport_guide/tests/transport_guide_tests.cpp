@@ -0,0 +1,8 @@
+#include "transport_guide_tests.h"
+
+int main() {
+  TestTransportManager();
+  BenchmarkTransportManager();
+
+  return 0;
+}
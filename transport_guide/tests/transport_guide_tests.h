@@ -0,0 +1,21 @@
+#pragma once
+
+#include "transport_manager.h"
+#include "transport_manager_command.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+void TestTransportManager();
+void BenchmarkTransportManager();
+
+// Square city of side * side stops with a linear bus along every row and
+// every column, neighbouring stops are 400 to 1000 meters apart; all buses
+// share the given intervals
+std::unique_ptr<TransportManager> MakeGridCity(size_t side, RoutingSettings routing_settings = {6, 40},
+                                               const std::vector<BusInterval>& intervals = {});
+
+// Random stops with a few road distances each and random buses over them,
+// shuffled the way base_requests usually come
+std::vector<std::unique_ptr<InCommand>> MakeRandomBaseRequests(size_t stop_count, size_t bus_count, unsigned int seed);
@@ -0,0 +1,484 @@
+#include "transport_guide_tests.h"
+
+#include "binary_format.h"
+#include "graph.h"
+#include "json.h"
+#include "json_parser.h"
+#include "profile.h"
+#include "road_distances.h"
+#include "router.h"
+#include "spatial_index.h"
+#include "timetable.h"
+#include "transport_manager.h"
+
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+unique_ptr<TransportManager> MakeGridCity(size_t side, RoutingSettings routing_settings, const vector<BusInterval>& intervals) {
+  auto manager = make_unique<TransportManager>(routing_settings);
+  mt19937 generator{42};
+  uniform_int_distribution<unsigned int> distance{400, 1000};
+
+  auto stop_name = [side](size_t row, size_t column) {
+    return "Stop " + to_string(row * side + column);
+  };
+
+  for (size_t row = 0; row < side; ++row) {
+    for (size_t column = 0; column < side; ++column) {
+      unordered_map<string, unsigned int> distances;
+      if (row + 1 < side) {
+        distances[stop_name(row + 1, column)] = distance(generator);
+      }
+      if (column + 1 < side) {
+        distances[stop_name(row, column + 1)] = distance(generator);
+      }
+      manager->AddStop(stop_name(row, column), 55.5 + 0.005 * row, 37.5 + 0.008 * column, distances);
+    }
+  }
+
+  for (size_t line = 0; line < side; ++line) {
+    vector<string> row_stops;
+    vector<string> column_stops;
+    for (size_t i = 0; i < side; ++i) {
+      row_stops.push_back(stop_name(line, i));
+      column_stops.push_back(stop_name(i, line));
+    }
+    manager->AddBus("R" + to_string(line), row_stops, false, intervals);
+    manager->AddBus("C" + to_string(line), column_stops, false, intervals);
+  }
+
+  manager->CreateRoutes();
+  return manager;
+}
+
+vector<unique_ptr<InCommand>> MakeRandomBaseRequests(size_t stop_count, size_t bus_count, unsigned int seed) {
+  mt19937 generator{seed};
+  uniform_int_distribution<size_t> stop{0, stop_count - 1};
+  uniform_int_distribution<unsigned int> distance{100, 5000};
+  uniform_int_distribution<size_t> route_size{2, 10};
+
+  vector<unique_ptr<InCommand>> commands;
+  for (size_t i = 0; i < stop_count; ++i) {
+    unordered_map<string, unsigned int> distances;
+    for (size_t j = 0; j < 4; ++j) {
+      distances["Stop " + to_string(stop(generator))] = distance(generator);
+    }
+    commands.push_back(make_unique<NewStopCommand>("Stop " + to_string(i), 55.5 + 0.2 * i / stop_count,
+                                                   37.5 + 0.2 * stop(generator) / stop_count, move(distances)));
+  }
+  for (size_t i = 0; i < bus_count; ++i) {
+    vector<string> stops(route_size(generator));
+    for (auto& stop_name : stops) {
+      stop_name = "Stop " + to_string(stop(generator));
+    }
+    const bool roundtrip = i % 2 == 0;
+    if (roundtrip) {
+      stops.push_back(stops.front());
+    }
+    commands.push_back(make_unique<NewBusCommand>("Bus " + to_string(i), move(stops), roundtrip));
+  }
+  shuffle(begin(commands), end(commands), generator);
+  return commands;
+}
+
+// Routing graph of MakeGridCity laid out the way CreateRoutes does it: stop
+// i has a wait vertex 2i and a boarding vertex 2i + 1, and every bus has an
+// edge from each of its stops to every later one
+pair<TransportManager::RoadGraph, vector<uint32_t>> MakeGridRoadGraph(size_t side, RoutingSettings routing_settings) {
+  using GraphId = TransportManager::GraphId;
+  using RouteWeight = TransportManager::RouteWeight;
+
+  mt19937 generator{42};
+  uniform_int_distribution<unsigned int> distance{400, 1000};
+  const double meters_per_minute = routing_settings.bus_velocity * 1000 / 60;
+
+  TransportManager::RoadGraph graph(2 * side * side);
+  vector<uint32_t> boardings;
+  for (GraphId stop = 0; stop < side * side; ++stop) {
+    graph.AddEdge({2 * stop, 2 * stop + 1, static_cast<RouteWeight>(routing_settings.bus_wait_time)});
+    boardings.push_back(1);
+  }
+
+  const auto add_bus = [&](const vector<GraphId>& stops, const vector<double>& hop_times) {
+    for (size_t i = 0; i < stops.size(); ++i) {
+      double time_sum = 0;
+      for (size_t j = i + 1; j < stops.size(); ++j) {
+        time_sum += hop_times[j - 1];
+        graph.AddEdge({2 * stops[i] + 1, 2 * stops[j], static_cast<RouteWeight>(time_sum)});
+        boardings.push_back(0);
+      }
+    }
+  };
+  for (size_t line = 0; line < 2 * side; ++line) {
+    // Rows, then columns; linear buses go there and back
+    vector<GraphId> stops;
+    vector<double> hop_times;
+    for (size_t i = 0; i < side; ++i) {
+      stops.push_back(static_cast<GraphId>(line < side ? line * side + i : i * side + line - side));
+    }
+    for (size_t i = 0; i + 1 < side; ++i) {
+      hop_times.push_back(distance(generator) / meters_per_minute);
+    }
+    for (size_t i = side - 1; i-- > 0;) {
+      stops.push_back(stops[i]);
+      hop_times.push_back(hop_times[i]);
+    }
+    add_bus(stops, hop_times);
+  }
+  return {move(graph), move(boardings)};
+}
+
+// Textbook Dijkstra from scratch for one query, the single criterion search
+// a ParetoRouter query is measured against
+template <typename Weight, typename Id>
+optional<Weight> FindShortestPathWeight(const Graph::DirectedWeightedGraph<Weight, Id>& graph, Id from, Id to) {
+  vector<Weight> weights(graph.GetVertexCount(), numeric_limits<Weight>::max());
+  priority_queue<pair<Weight, Id>, vector<pair<Weight, Id>>, greater<>> queue;
+  weights[from] = 0;
+  queue.push({0, from});
+  while (!queue.empty()) {
+    const auto [weight, vertex] = queue.top();
+    queue.pop();
+    if (vertex == to) {
+      return weight;
+    }
+    if (weight > weights[vertex]) {
+      continue;
+    }
+    for (const Id edge_id : graph.GetIncidentEdges(vertex)) {
+      const auto& edge = graph.GetEdge(edge_id);
+      if (weight + edge.weight < weights[edge.to]) {
+        weights[edge.to] = weight + edge.weight;
+        queue.push({weights[edge.to], edge.to});
+      }
+    }
+  }
+  return nullopt;
+}
+
+void BenchmarkParetoRoutes() {
+  using GraphId = TransportManager::GraphId;
+  using RouteWeight = TransportManager::RouteWeight;
+
+  const size_t side = 16;
+  const size_t query_count = 2'000;
+  const auto [graph, boardings] = MakeGridRoadGraph(side, {6, 40});
+  const Graph::ParetoRouter<RouteWeight, GraphId> pareto_router(graph, boardings);
+
+  mt19937 generator{7};
+  uniform_int_distribution<GraphId> stop{0, static_cast<GraphId>(side * side - 1)};
+  vector<pair<GraphId, GraphId>> queries;
+  for (size_t i = 0; i < query_count; ++i) {
+    queries.emplace_back(2 * stop(generator), 2 * stop(generator));
+  }
+
+  double dijkstra_checksum = 0;
+  double pareto_checksum = 0;
+  size_t routes = 0;
+  const auto measure = [](const string& title, auto query) {
+    const auto start = chrono::steady_clock::now();
+    query();
+    const double duration = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cerr << title << ": " << duration << " ms" << endl;
+    return duration;
+  };
+
+  const double dijkstra_time = measure("Dijkstra per query, 2000 queries", [&] {
+    for (const auto& [from, to] : queries) {
+      dijkstra_checksum += FindShortestPathWeight(graph, from, to).value_or(0);
+    }
+  });
+  const double single_time = measure("ParetoRouter, max_routes = 1, 2000 queries", [&] {
+    for (const auto& [from, to] : queries) {
+      const auto found = pareto_router.BuildRoutes(from, to, 1);
+      pareto_checksum += found.empty() ? 0 : found.front().weight;
+    }
+  });
+  const double full_time = measure("ParetoRouter, max_routes = 4, 2000 queries", [&] {
+    for (const auto& [from, to] : queries) {
+      routes += pareto_router.BuildRoutes(from, to, 4).size();
+    }
+  });
+
+  cerr << "ParetoRouter against Dijkstra on the same graph: "
+       << single_time / dijkstra_time << "x with max_routes = 1, "
+       << full_time / dijkstra_time << "x with max_routes = 4" << endl;
+  cerr << "ParetoRoute benchmark checksums: " << dijkstra_checksum << " " << pareto_checksum
+       << ", " << routes << " routes" << endl;
+}
+
+template <typename Weight, typename Id>
+void BenchmarkRouterInstantiation(const string& name, size_t vertex_count, size_t edge_count) {
+  mt19937 generator{13};
+  uniform_int_distribution<size_t> vertex{0, vertex_count - 1};
+  uniform_real_distribution<double> weight{1.0, 30.0};
+
+  Graph::DirectedWeightedGraph<Weight, Id> graph(vertex_count);
+  for (size_t i = 0; i < edge_count; ++i) {
+    graph.AddEdge(Graph::Edge<Weight, Id>{
+      static_cast<Id>(vertex(generator)),
+      static_cast<Id>(vertex(generator)),
+      static_cast<Weight>(weight(generator)),
+    });
+  }
+
+  cerr << name << ": sizeof(Edge) = " << sizeof(Graph::Edge<Weight, Id>) << endl;
+  unique_ptr<Graph::Router<Weight, Id>> router;
+  {
+    LOG_DURATION(name + ", router construction");
+    router = make_unique<Graph::Router<Weight, Id>>(graph);
+  }
+
+  double checksum = 0;
+  {
+    LOG_DURATION(name + ", 1'000'000 weight lookups");
+    for (size_t i = 0; i < 1'000'000; ++i) {
+      checksum += router->GetRouteWeight(vertex(generator), vertex(generator)).value_or(0);
+    }
+  }
+  {
+    LOG_DURATION(name + ", 100'000 built routes");
+    for (size_t i = 0; i < 100'000; ++i) {
+      if (auto route = router->BuildRoute(vertex(generator), vertex(generator))) {
+        checksum += route->edge_count;
+        router->ReleaseRoute(route->id);
+      }
+    }
+  }
+  cerr << name << " checksum: " << checksum << endl;
+}
+
+void BenchmarkRouterInstantiations() {
+  const size_t vertex_count = 800;
+  const size_t edge_count = 20'000;
+  BenchmarkRouterInstantiation<double, size_t>("Router<double, size_t>", vertex_count, edge_count);
+  BenchmarkRouterInstantiation<float, uint32_t>("Router<float, uint32_t>", vertex_count, edge_count);
+}
+
+void BenchmarkRoadDistances() {
+  const size_t stop_count = 100'000;
+  const size_t distance_count = 1'000'000;
+  mt19937 generator{17};
+  uniform_int_distribution<StopId> stop{0, stop_count - 1};
+  vector<tuple<StopId, StopId, unsigned int>> records;
+  for (size_t i = 0; i < distance_count; ++i) {
+    records.emplace_back(stop(generator), stop(generator), 100 + i % 5000);
+  }
+
+  size_t map_checksum = 0;
+  size_t csr_checksum = 0;
+  {
+    LOG_DURATION("unordered_map of unordered_map, 1M distances ingested and queried");
+    unordered_map<size_t, unordered_map<size_t, unsigned int>> distances;
+    for (const auto& [from, to, meters] : records) {
+      distances[from][to] = meters;
+      if (!distances[to].count(from) || distances[to][from] == 0) {
+        distances[to][from] = meters;
+      }
+    }
+    for (const auto& [from, to, meters] : records) {
+      map_checksum += distances[to][from];
+    }
+  }
+  {
+    LOG_DURATION("RoadDistances, 1M distances ingested, frozen and queried");
+    RoadDistances distances;
+    for (const auto& [from, to, meters] : records) {
+      distances.Add(from, to, meters);
+    }
+    distances.Freeze(stop_count);
+    for (const auto& [from, to, meters] : records) {
+      csr_checksum += distances.Get(to, from);
+    }
+  }
+  cerr << "RoadDistances benchmark checksums: " << map_checksum << " " << csr_checksum << endl;
+}
+
+void BenchmarkParallelIngestion() {
+  const auto commands = MakeRandomBaseRequests(200'000, 20'000, 3);
+  const size_t max_threads = max(4u, thread::hardware_concurrency());
+  for (size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+    TransportManager manager{RoutingSettings{6, 40}};
+    LOG_DURATION("AddBaseRequests, 200k stops and 20k buses, " + to_string(thread_count) + " threads");
+    manager.AddBaseRequests(commands, thread_count);
+  }
+}
+
+void BenchmarkNearestStops() {
+  const size_t stop_count = 100'000;
+  const size_t query_count = 1'000'000;
+  mt19937 generator{23};
+  uniform_real_distribution<double> latitude{55.5, 55.9};
+  uniform_real_distribution<double> longitude{37.3, 37.9};
+  vector<SpatialIndex::Point> points;
+  for (StopId id = 0; id < stop_count; ++id) {
+    points.push_back({id, {latitude(generator), longitude(generator)}});
+  }
+  vector<Coordinates> queries;
+  for (size_t i = 0; i < query_count; ++i) {
+    queries.push_back({latitude(generator), longitude(generator)});
+  }
+
+  SpatialIndex index;
+  {
+    LOG_DURATION("SpatialIndex, 100k stops indexed");
+    index = SpatialIndex{points};
+  }
+  size_t checksum = 0;
+  {
+    LOG_DURATION("SpatialIndex, 1M nearest stop lookups");
+    for (const auto& point : queries) {
+      checksum += index.FindNearest(point, 1).front().id;
+    }
+  }
+  {
+    LOG_DURATION("SpatialIndex, 1M lookups of 3 nearest stops");
+    for (const auto& point : queries) {
+      checksum += index.FindNearest(point, 3).back().id;
+    }
+  }
+  {
+    LOG_DURATION("Linear scan, 100 nearest stop lookups");
+    for (size_t i = 0; i < 100; ++i) {
+      auto nearest = min_element(begin(points), end(points), [&point = queries[i]](const auto& lhs, const auto& rhs) {
+        return Coordinates::Distance(point, lhs.coordinates) < Coordinates::Distance(point, rhs.coordinates);
+      });
+      checksum += nearest->id;
+    }
+  }
+  cerr << "SpatialIndex benchmark checksum: " << checksum << endl;
+}
+
+void BenchmarkTimetable() {
+  const size_t stop_count = 2'000;
+  const size_t bus_count = 300;
+  const size_t stops_per_bus = 25;
+  const double headway = 8;
+  mt19937 generator{29};
+  uniform_int_distribution<StopId> stop{0, stop_count - 1};
+  uniform_real_distribution<double> hop_time{1, 3};
+
+  vector<Timetable::Connection> connections;
+  uint32_t trip_count = 0;
+  for (size_t bus = 0; bus < bus_count; ++bus) {
+    vector<StopId> stops;
+    vector<double> offsets{0};
+    for (size_t i = 0; i < stops_per_bus; ++i) {
+      stops.push_back(stop(generator));
+    }
+    // There and back, as linear routes are driven
+    for (size_t i = stops_per_bus - 1; i-- > 0;) {
+      stops.push_back(stops[i]);
+    }
+    for (size_t i = 1; i < stops.size(); ++i) {
+      offsets.push_back(offsets.back() + hop_time(generator));
+    }
+    for (double start = 5 * 60 + bus % 8; start < 24 * 60; start += headway, ++trip_count) {
+      for (size_t i = 0; i + 1 < stops.size(); ++i) {
+        connections.push_back({stops[i], stops[i + 1], start + offsets[i], start + offsets[i + 1], trip_count, static_cast<uint32_t>(i)});
+      }
+    }
+  }
+  cerr << "Timetable: " << connections.size() << " connections in " << trip_count << " trips" << endl;
+
+  Timetable timetable;
+  {
+    LOG_DURATION("Timetable construction");
+    timetable = Timetable(stop_count, trip_count, move(connections));
+  }
+
+  const size_t query_count = 10'000;
+  uniform_real_distribution<double> departure{6 * 60, 22 * 60};
+  double checksum = 0;
+  size_t found = 0;
+  {
+    LOG_DURATION("Timetable, 10'000 earliest arrival queries");
+    for (size_t i = 0; i < query_count; ++i) {
+      if (auto journey = timetable.FindEarliestArrival(stop(generator), stop(generator), departure(generator))) {
+        checksum += journey->arrival;
+        ++found;
+      }
+    }
+  }
+  cerr << "Timetable benchmark: " << found << " journeys found, checksum " << checksum << endl;
+}
+
+void BenchmarkBinaryFormat() {
+  auto manager = MakeGridCity(20);
+  mt19937 generator{31};
+  uniform_int_distribution<size_t> stop{0, 399};
+  vector<StopInfo> stop_info;
+  vector<BusInfo> bus_info;
+  vector<RouteInfo> route_data;
+  for (size_t i = 0; i < 400; ++i) {
+    stop_info.push_back(manager->GetStopInfo("Stop " + to_string(i), i));
+  }
+  for (size_t i = 0; i < 20; ++i) {
+    bus_info.push_back(manager->GetBusInfo("R" + to_string(i), 400 + 2 * i));
+    bus_info.push_back(manager->GetBusInfo("C" + to_string(i), 401 + 2 * i));
+  }
+  for (size_t i = 0; i < 100'000; ++i) {
+    route_data.push_back(manager->GetRouteInfo("Stop " + to_string(stop(generator)), "Stop " + to_string(stop(generator)), 440 + i));
+  }
+
+  string json;
+  string binary;
+  {
+    LOG_DURATION("JSON, 100k routes encoded");
+    ostringstream output;
+    JsonArgs::PrintResults(stop_info, bus_info, route_data, {}, {}, {}, {}, {}, {}, output);
+    json = output.str();
+  }
+  {
+    LOG_DURATION("Binary, 100k routes encoded");
+    binary = BinaryArgs::EncodeResults(stop_info, bus_info, route_data);
+  }
+  cerr << "JSON: " << json.size() << " bytes, binary: " << binary.size() << " bytes" << endl;
+
+  size_t json_items = 0;
+  size_t binary_items = 0;
+  {
+    LOG_DURATION("JSON, 100k routes decoded");
+    istringstream input{json};
+    const auto document = Json::Load(input);
+    for (const auto& response : document.GetRoot().AsArray()) {
+      if (auto it = response.AsMap().find("items"); it != response.AsMap().end()) {
+        json_items += it->second.AsArray().size();
+      }
+    }
+  }
+  {
+    LOG_DURATION("Binary, 100k routes decoded");
+    const auto results = BinaryArgs::DecodeResults(binary);
+    for (const auto& route : results.route_data) {
+      binary_items += route.items.size();
+    }
+  }
+  cerr << "Decoded route items: " << json_items << " " << binary_items << endl;
+}
+
+void BenchmarkTransportManager() {
+  BenchmarkParetoRoutes();
+  BenchmarkRouterInstantiations();
+  BenchmarkRoadDistances();
+  BenchmarkParallelIngestion();
+  BenchmarkNearestStops();
+  BenchmarkTimetable();
+  BenchmarkBinaryFormat();
+}
@@ -0,0 +1,523 @@
+#include "transport_guide_tests.h"
+
+#include "binary_format.h"
+#include "json_parser.h"
+#include "memory_usage.h"
+#include "road_distances.h"
+#include "spatial_index.h"
+#include "test_runner.h"
+#include "transport_manager.h"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// One direct slow bus A - C, a faster pair of buses A - B - C and a stop D
+// without buses
+TransportManager MakeTransferNetwork() {
+  TransportManager manager{RoutingSettings{2, 60}};
+  manager.AddStop("A", 55.60, 37.60, {{"B", 1000}, {"C", 6000}});
+  manager.AddStop("B", 55.61, 37.60, {{"C", 1000}});
+  manager.AddStop("C", 55.62, 37.60, {});
+  manager.AddStop("D", 55.63, 37.60, {});
+  manager.AddBus("direct", {"A", "C"}, false);
+  manager.AddBus("1", {"A", "B"}, false);
+  manager.AddBus("2", {"B", "C"}, false);
+  manager.CreateRoutes();
+  return manager;
+}
+
+}
+
+void TestRoadDistances() {
+  RoadDistances distances;
+  distances.Add(0, 1, 100);
+  distances.Add(1, 0, 200);
+  distances.Add(2, 3, 300);
+  distances.Add(3, 2, 0);
+  distances.Add(4, 4, 50);
+  distances.Add(5, 2, 70);
+  distances.Freeze(6);
+
+  ASSERT_EQUAL(distances.Get(0, 1), 100u);
+  ASSERT_EQUAL(distances.Get(1, 0), 200u);
+  ASSERT_EQUAL(distances.Get(2, 3), 300u);
+  ASSERT_EQUAL(distances.Get(3, 2), 0u);
+  ASSERT_EQUAL(distances.Get(4, 4), 50u);
+  ASSERT_EQUAL(distances.Get(2, 5), 70u);
+  ASSERT_EQUAL(distances.Get(5, 2), 70u);
+  ASSERT_EQUAL(distances.Get(0, 2), 0u);
+  ASSERT_EQUAL(distances.Get(10, 2), 0u);
+
+  ASSERT_THROWS(([&distances] { distances.Add(0, 1, 1); }));
+}
+
+void TestParetoRoutes() {
+  auto manager = MakeTransferNetwork();
+
+  {
+    auto route = manager.GetRouteInfo("A", "C", 1);
+    ASSERT_EQUAL(route.total_time, 6.0);
+  }
+
+  {
+    auto pareto = manager.GetParetoRouteInfo("A", "C", 4, 2);
+    ASSERT(!pareto.error_message.has_value());
+    ASSERT_EQUAL(pareto.routes.size(), 2u);
+
+    ASSERT_EQUAL(pareto.routes[0].total_time, 6.0);
+    ASSERT_EQUAL(pareto.routes[0].transfer_count, 1u);
+    ASSERT_EQUAL(pareto.routes[0].items.size(), 4u);
+
+    ASSERT_EQUAL(pareto.routes[1].total_time, 8.0);
+    ASSERT_EQUAL(pareto.routes[1].transfer_count, 0u);
+    ASSERT_EQUAL(pareto.routes[1].items.size(), 2u);
+    ASSERT_EQUAL(get<BusActivity>(pareto.routes[1].items[1]).bus, string("direct"));
+  }
+
+  {
+    auto pareto = manager.GetParetoRouteInfo("A", "C", 1, 3);
+    ASSERT_EQUAL(pareto.routes.size(), 1u);
+    ASSERT_EQUAL(pareto.routes[0].total_time, 6.0);
+  }
+
+  {
+    auto pareto = manager.GetParetoRouteInfo("C", "D", 4, 4);
+    ASSERT(pareto.error_message.has_value());
+    ASSERT(pareto.routes.empty());
+  }
+
+  {
+    auto pareto = manager.GetParetoRouteInfo("A", "Nowhere", 4, 5);
+    ASSERT(pareto.error_message.has_value());
+  }
+}
+
+void TestParetoRoutesMatchFastestRoute() {
+  auto manager = MakeGridCity(6);
+  for (size_t from = 0; from < 36; from += 5) {
+    for (size_t to = 0; to < 36; to += 7) {
+      const auto from_name = "Stop " + to_string(from);
+      const auto to_name = "Stop " + to_string(to);
+      const auto route = manager->GetRouteInfo(from_name, to_name, 0);
+      const auto pareto = manager->GetParetoRouteInfo(from_name, to_name, 4, 0);
+      ASSERT_EQUAL(pareto.routes.front().total_time, route.total_time);
+      for (size_t i = 1; i < pareto.routes.size(); ++i) {
+        ASSERT(pareto.routes[i - 1].total_time < pareto.routes[i].total_time);
+        ASSERT(pareto.routes[i - 1].transfer_count > pareto.routes[i].transfer_count);
+      }
+    }
+  }
+}
+
+void TestRouteMatrix() {
+  auto manager = MakeGridCity(6);
+  vector<string> from;
+  vector<string> to;
+  for (size_t i = 0; i < 36; i += 5) {
+    from.push_back("Stop " + to_string(i));
+  }
+  for (size_t i = 0; i < 36; i += 3) {
+    to.push_back("Stop " + to_string(i));
+  }
+
+  const auto matrix = manager->GetRouteMatrix(from, to, 1);
+  ASSERT(!matrix.error_message.has_value());
+  ASSERT_EQUAL(matrix.column_count, to.size());
+  ASSERT_EQUAL(matrix.total_times.size(), from.size() * to.size());
+  for (size_t row = 0; row < from.size(); ++row) {
+    for (size_t column = 0; column < to.size(); ++column) {
+      const auto& total_time = matrix.total_times[row * to.size() + column];
+      ASSERT(total_time.has_value());
+      ASSERT_EQUAL(*total_time, manager->GetRouteInfo(from[row], to[column], 0).total_time);
+    }
+  }
+
+  auto network = MakeTransferNetwork();
+  const auto with_unreachable = network.GetRouteMatrix({"A", "D"}, {"C", "D"}, 2);
+  ASSERT(with_unreachable.total_times[0].has_value());
+  ASSERT(!with_unreachable.total_times[1].has_value());
+  ASSERT(!with_unreachable.total_times[2].has_value());
+  ASSERT(with_unreachable.total_times[3].has_value());
+
+  ASSERT(network.GetRouteMatrix({"A"}, {"Nowhere"}, 3).error_message.has_value());
+}
+
+// Road distances of random bases do not divide evenly into minutes, so
+// times summed from float weights would differ from the ones of Route
+void TestRouteTimesMatchRoute() {
+  const size_t stop_count = 80;
+  TransportManager manager{RoutingSettings{6, 40}};
+  manager.AddBaseRequests(MakeRandomBaseRequests(stop_count, 30, 11), 1);
+  manager.CreateRoutes();
+
+  vector<string> names;
+  for (size_t i = 0; i < stop_count; ++i) {
+    names.push_back("Stop " + to_string(i));
+  }
+  const auto matrix = manager.GetRouteMatrix(names, names, 1);
+  for (size_t from = 0; from < stop_count; ++from) {
+    const auto isochrone = manager.GetIsochrone(names[from], 1e9, 2);
+    unordered_map<string, double> isochrone_times;
+    for (const auto& stop : isochrone.stops) {
+      isochrone_times[stop.stop_name] = stop.total_time;
+    }
+
+    for (size_t to = 0; to < stop_count; ++to) {
+      const auto route = manager.GetRouteInfo(names[from], names[to], 3);
+      const auto& total_time = matrix.total_times[from * stop_count + to];
+      ASSERT_EQUAL(total_time.has_value(), !route.error_message.has_value());
+      ASSERT_EQUAL(isochrone_times.count(names[to]) > 0, !route.error_message.has_value());
+      // Exactly, ASSERT_EQUAL compares doubles with a tolerance
+      if (total_time) {
+        ASSERT(*total_time == route.total_time);
+        ASSERT(isochrone_times.at(names[to]) == route.total_time);
+      }
+    }
+  }
+}
+
+void TestIsochrone() {
+  auto manager = MakeTransferNetwork();
+
+  const auto isochrone = manager.GetIsochrone("A", 6, 1);
+  ASSERT(!isochrone.error_message.has_value());
+  ASSERT_EQUAL(isochrone.stops.size(), 3u);
+  ASSERT_EQUAL(isochrone.stops[0].stop_name, string("A"));
+  ASSERT_EQUAL(isochrone.stops[1].stop_name, string("B"));
+  ASSERT_EQUAL(isochrone.stops[1].total_time, 3.0);
+  ASSERT_EQUAL(isochrone.stops[2].stop_name, string("C"));
+  ASSERT_EQUAL(isochrone.stops[2].total_time, 6.0);
+
+  ASSERT_EQUAL(manager.GetIsochrone("A", 5.5, 2).stops.size(), 2u);
+  ASSERT(manager.GetIsochrone("Nowhere", 10, 3).error_message.has_value());
+}
+
+void TestParallelIngestion() {
+  const size_t stop_count = 60;
+  const auto commands = MakeRandomBaseRequests(stop_count, 25, 11);
+
+  auto describe = [&commands, stop_count](size_t thread_count) {
+    TransportManager manager{RoutingSettings{4, 30}};
+    // A stop known before the requests keeps its id
+    manager.AddStop("Stop 3", 55.6, 37.6, {{"Stop 70", 500}});
+    manager.AddBaseRequests(commands, thread_count);
+    manager.CreateRoutes();
+
+    vector<StopInfo> stop_info;
+    vector<BusInfo> bus_info;
+    vector<RouteInfo> route_data;
+    for (size_t i = 0; i < stop_count; ++i) {
+      const auto name = "Stop " + to_string(i);
+      stop_info.push_back(manager.GetStopInfo(name, i));
+      route_data.push_back(manager.GetRouteInfo(name, "Stop " + to_string((i * 7) % stop_count), i));
+    }
+    for (size_t i = 0; i < 25; ++i) {
+      bus_info.push_back(manager.GetBusInfo("Bus " + to_string(i), i));
+    }
+
+    ostringstream output;
+    JsonArgs::PrintResults(stop_info, bus_info, route_data, {}, {}, {}, {}, {}, {}, output);
+    return output.str();
+  };
+
+  const auto sequential = describe(1);
+  for (size_t thread_count : {2, 3, 4, 7, 200}) {
+    ASSERT_EQUAL(describe(thread_count), sequential);
+  }
+}
+
+void TestSpatialIndex() {
+  mt19937 generator{5};
+  uniform_real_distribution<double> latitude{55.5, 55.9};
+  uniform_real_distribution<double> longitude{37.3, 37.9};
+  vector<SpatialIndex::Point> points;
+  for (StopId id = 0; id < 500; ++id) {
+    points.push_back({id, {latitude(generator), longitude(generator)}});
+  }
+  const SpatialIndex index{points};
+  ASSERT_EQUAL(index.Size(), points.size());
+
+  for (size_t query = 0; query < 100; ++query) {
+    const Coordinates point{latitude(generator), longitude(generator)};
+
+    vector<double> expected;
+    for (const auto& p : points) {
+      expected.push_back(static_cast<double>(Coordinates::Distance(point, p.coordinates)));
+    }
+    sort(begin(expected), end(expected));
+    const auto nearest = index.FindNearest(point, 5);
+    ASSERT_EQUAL(nearest.size(), 5u);
+    for (size_t i = 0; i < nearest.size(); ++i) {
+      ASSERT_EQUAL(nearest[i].distance, expected[i]);
+      ASSERT_EQUAL(nearest[i].distance, static_cast<double>(Coordinates::Distance(point, points[nearest[i].id].coordinates)));
+    }
+
+    const Coordinates other{latitude(generator), longitude(generator)};
+    const Coordinates min_corner{min(point.latitude, other.latitude), min(point.longitude, other.longitude)};
+    const Coordinates max_corner{max(point.latitude, other.latitude), max(point.longitude, other.longitude)};
+    vector<StopId> expected_in_box;
+    for (const auto& p : points) {
+      if (min_corner.latitude <= p.coordinates.latitude && p.coordinates.latitude <= max_corner.latitude
+          && min_corner.longitude <= p.coordinates.longitude && p.coordinates.longitude <= max_corner.longitude) {
+        expected_in_box.push_back(p.id);
+      }
+    }
+    auto in_box = index.FindInBox(min_corner, max_corner);
+    sort(begin(in_box), end(in_box));
+    ASSERT_EQUAL(in_box, expected_in_box);
+  }
+
+  ASSERT_EQUAL(index.FindNearest({55.7, 37.6}, 1000).size(), points.size());
+  ASSERT(SpatialIndex{}.FindNearest({55.7, 37.6}, 3).empty());
+
+  // The nearest stop may be across the antimeridian
+  vector<SpatialIndex::Point> seam_points;
+  for (StopId id = 0; id < 40; ++id) {
+    seam_points.push_back({id, {0, -179.99 + 9 * id}});
+  }
+  seam_points.push_back({40, {0, 170}});
+  seam_points.push_back({41, {0, 175}});
+  const SpatialIndex seam_index{seam_points};
+  ASSERT_EQUAL(seam_index.FindNearest({0, 179.99}, 1).front().id, 0u);
+  ASSERT_EQUAL(seam_index.FindNearest({0.001, -179.999}, 1).front().id, 0u);
+
+  uniform_real_distribution<double> seam_latitude{-70, 70};
+  uniform_real_distribution<double> seam_offset{-5, 5};
+  auto seam_longitude = [&generator, &seam_offset] {
+    const double offset = seam_offset(generator);
+    return offset < 0 ? 180 + offset : -180 + offset;
+  };
+  seam_points.clear();
+  for (StopId id = 0; id < 300; ++id) {
+    seam_points.push_back({id, {seam_latitude(generator), seam_longitude()}});
+  }
+  const SpatialIndex random_seam_index{seam_points};
+  for (size_t query = 0; query < 100; ++query) {
+    const Coordinates point{seam_latitude(generator), seam_longitude()};
+    vector<double> expected;
+    for (const auto& p : seam_points) {
+      expected.push_back(static_cast<double>(Coordinates::Distance(point, p.coordinates)));
+    }
+    sort(begin(expected), end(expected));
+    const auto nearest = random_seam_index.FindNearest(point, 3);
+    for (size_t i = 0; i < nearest.size(); ++i) {
+      ASSERT_EQUAL(nearest[i].distance, expected[i]);
+    }
+  }
+}
+
+void TestStopLookupsByCoordinates() {
+  auto manager = MakeTransferNetwork();
+
+  const auto nearest = manager.GetNearestStops({55.612, 37.60}, 3, 1);
+  ASSERT_EQUAL(nearest.stops.size(), 3u);
+  ASSERT_EQUAL(nearest.stops[0].stop_name, string("B"));
+  ASSERT_EQUAL(nearest.stops[1].stop_name, string("C"));
+  ASSERT_EQUAL(nearest.stops[2].stop_name, string("A"));
+
+  const auto in_box = manager.GetStopsInBox({55.605, 37.5}, {55.625, 37.7}, 2);
+  ASSERT_EQUAL(in_box.stops, (vector<string>{"B", "C"}));
+  ASSERT(manager.GetStopsInBox({55.605, 37.61}, {55.625, 37.7}, 3).stops.empty());
+
+  const auto from_a = manager.GetRouteInfoFromPoint({55.601, 37.60}, "C", 1, 4);
+  ASSERT(!from_a.error_message.has_value());
+  ASSERT_EQUAL(from_a.total_time, manager.GetRouteInfo("A", "C", 5).total_time);
+
+  // D is the nearest stop but has no buses, the snap falls back to C itself
+  const auto near_d = manager.GetRouteInfoFromPoint({55.629, 37.60}, "C", 3, 6);
+  ASSERT(!near_d.error_message.has_value());
+  ASSERT_EQUAL(near_d.total_time, 0.0);
+  ASSERT(manager.GetRouteInfoFromPoint({55.629, 37.60}, "C", 1, 7).error_message.has_value());
+  ASSERT(manager.GetRouteInfoFromPoint({55.629, 37.60}, "Nowhere", 3, 8).error_message.has_value());
+}
+
+void TestTimedRoutes() {
+  TransportManager manager{RoutingSettings{2, 60}};
+  manager.AddStop("A", 55.60, 37.60, {{"B", 1000}, {"C", 6000}});
+  manager.AddStop("B", 55.61, 37.60, {{"C", 1000}});
+  manager.AddStop("C", 55.62, 37.60, {});
+  manager.AddStop("D", 55.63, 37.60, {});
+  manager.AddBus("direct", {"A", "C"}, false, {{0, 600, 30}});
+  manager.AddBus("1", {"A", "B"}, false, {{0, 600, 10}});
+  manager.AddBus("2", {"B", "C"}, false, {{5, 300, 10}, {300, 600, 30}});
+  // No intervals, no timetabled trips
+  manager.AddBus("untimed", {"A", "C"}, false);
+  manager.CreateRoutes();
+
+  const auto route = manager.GetTimedRouteInfo("A", "C", 1, 1);
+  ASSERT(!route.error_message.has_value());
+  ASSERT_EQUAL(route.total_time, 15.0);
+  ASSERT_EQUAL(route.items.size(), 4u);
+  const auto& first_wait = get<WaitActivity>(route.items[0]);
+  ASSERT_EQUAL(first_wait.stop_name, string("A"));
+  ASSERT_EQUAL(first_wait.time, 9.0);
+  const auto& first_bus = get<BusActivity>(route.items[1]);
+  ASSERT_EQUAL(first_bus.bus, string("1"));
+  ASSERT_EQUAL(first_bus.span_count, 1u);
+  ASSERT_EQUAL(get<WaitActivity>(route.items[2]).time, 4.0);
+  ASSERT_EQUAL(get<BusActivity>(route.items[3]).bus, string("2"));
+
+  // Bus 2 runs every 30 minutes after 300, the direct bus wins then
+  const auto evening = manager.GetTimedRouteInfo("A", "C", 329, 2);
+  ASSERT_EQUAL(evening.total_time, 7.0);
+  ASSERT_EQUAL(get<BusActivity>(evening.items[1]).bus, string("direct"));
+
+  // The last trips have left, and the untimed bus never runs
+  ASSERT(manager.GetTimedRouteInfo("A", "C", 595, 3).error_message.has_value());
+  ASSERT(!manager.GetRouteInfo("A", "C", 3).error_message.has_value());
+  ASSERT(manager.GetTimedRouteInfo("A", "D", 0, 4).error_message.has_value());
+  ASSERT(manager.GetTimedRouteInfo("A", "Nowhere", 0, 5).error_message.has_value());
+  ASSERT_EQUAL(manager.GetTimedRouteInfo("B", "B", 0, 6).items.size(), 0u);
+
+  ASSERT_THROWS([&manager] { manager.AddBus("broken", {"A", "B"}, false, {{0, 600, 0}}); });
+}
+
+void TestTimedRoutesOnGridCity() {
+  const RoutingSettings settings{6, 40};
+  // Buses leave every 2 * bus_wait_time, which makes the average wait match
+  // the fixed one
+  auto manager = MakeGridCity(6, settings, {{0, 24 * 60, 2.0 * settings.bus_wait_time}});
+  for (size_t from = 0; from < 36; from += 5) {
+    for (size_t to = 0; to < 36; to += 7) {
+      const auto from_name = "Stop " + to_string(from);
+      const auto to_name = "Stop " + to_string(to);
+      const auto fixed = manager->GetRouteInfo(from_name, to_name, 0);
+      const auto timed = manager->GetTimedRouteInfo(from_name, to_name, 8 * 60 + from, 1);
+      ASSERT(!timed.error_message.has_value());
+
+      double total_time = 0;
+      size_t boardings = 0;
+      for (const auto& item : timed.items) {
+        if (holds_alternative<WaitActivity>(item)) {
+          const double wait = get<WaitActivity>(item).time;
+          ASSERT(0 <= wait && wait < 2 * settings.bus_wait_time);
+          total_time += wait;
+        } else {
+          total_time += get<BusActivity>(item).time;
+          ++boardings;
+        }
+      }
+      ASSERT_EQUAL(total_time, timed.total_time);
+
+      // Following the fixed route waits at most bus_wait_time more per boarding
+      size_t fixed_boardings = 0;
+      for (const auto& item : fixed.items) {
+        fixed_boardings += holds_alternative<WaitActivity>(item);
+      }
+      ASSERT(timed.total_time <= fixed.total_time + settings.bus_wait_time * fixed_boardings + 1e-6);
+    }
+  }
+}
+
+void TestBinaryFormat() {
+  auto manager = MakeGridCity(5, {6, 40}, {{0, 24 * 60, 12}});
+  vector<StopInfo> stop_info{manager->GetStopInfo("Stop 3", 1), manager->GetStopInfo("Nowhere", 2)};
+  vector<BusInfo> bus_info{manager->GetBusInfo("R1", 3), manager->GetBusInfo("C4", 4), manager->GetBusInfo("X", 5)};
+  vector<RouteInfo> route_data{manager->GetRouteInfo("Stop 0", "Stop 24", 6), manager->GetRouteInfo("Stop 7", "Stop 7", 7),
+                               manager->GetTimedRouteInfo("Stop 2", "Stop 21", 601.5, 8)};
+
+  const auto encoded = BinaryArgs::EncodeResults(stop_info, bus_info, route_data);
+  ASSERT_EQUAL(encoded.substr(0, 8), string("TGBR\x01\x00\x03\x00", 8));
+
+  const auto decoded = BinaryArgs::DecodeResults(encoded);
+  auto to_json = [](const vector<StopInfo>& stops, const vector<BusInfo>& buses, const vector<RouteInfo>& routes) {
+    ostringstream output;
+    JsonArgs::PrintResults(stops, buses, routes, {}, {}, {}, {}, {}, {}, output);
+    return output.str();
+  };
+  ASSERT_EQUAL(to_json(decoded.stop_info, decoded.bus_info, decoded.route_data), to_json(stop_info, bus_info, route_data));
+
+  istringstream input{encoded};
+  ASSERT_EQUAL(BinaryArgs::ReadResults(input).route_data.size(), route_data.size());
+
+  ASSERT_THROWS([&encoded] { BinaryArgs::DecodeResults(string_view{encoded}.substr(0, encoded.size() - 1)); });
+  ASSERT_THROWS([&encoded] { BinaryArgs::DecodeResults("JSON" + encoded.substr(4)); });
+  ASSERT_EQUAL(BinaryArgs::DecodeResults(BinaryArgs::EncodeResults({}, {}, {})).route_data.size(), 0u);
+
+  // Counts the data cannot hold are rejected before anything is allocated
+  auto rejects_count = [](string corrupt, size_t offset) {
+    corrupt.replace(offset, 4, 4, '\xFF');
+    try {
+      BinaryArgs::DecodeResults(corrupt);
+    } catch (const invalid_argument&) {
+      return true;
+    }
+    return false;
+  };
+  // Record count of the stop section and bus count of its first record
+  ASSERT(rejects_count(encoded, 9));
+  ASSERT(rejects_count(encoded, 34));
+  // Item count of a route after the two empty sections
+  ASSERT(rejects_count(BinaryArgs::EncodeResults({}, {}, {route_data[0]}), 68));
+}
+
+void TestMemoryUsage() {
+  ASSERT_EQUAL(Memory::HeapBytes(string("short")), 0u);
+  const string long_name(100, 'x');
+  ASSERT(Memory::HeapBytes(long_name) > long_name.size());
+
+  vector<int> numbers;
+  numbers.reserve(10);
+  ASSERT_EQUAL(Memory::HeapBytes(numbers), 10 * sizeof(int));
+  vector<string> names(2, long_name);
+  ASSERT_EQUAL(Memory::HeapBytes(names), names.capacity() * sizeof(string) + 2 * Memory::HeapBytes(long_name));
+
+  auto manager = MakeGridCity(6);
+  const auto usage = manager->GetMemoryUsage(1);
+  ASSERT_EQUAL(usage.request_id, 1u);
+  size_t total_bytes = 0;
+  size_t router_bytes = 0;
+  for (const auto& component : usage.components) {
+    ASSERT(component.bytes > 0);
+    total_bytes += component.bytes;
+    if (component.name == "router") {
+      router_bytes = component.bytes;
+    }
+  }
+  ASSERT_EQUAL(usage.total_bytes, total_bytes);
+  // The all-pairs table alone holds a weight for every pair of vertices
+  const size_t vertex_count = 2 * 36;
+  ASSERT(router_bytes >= vertex_count * vertex_count * sizeof(TransportManager::RouteWeight));
+
+  auto stops_bytes = [](const TransportManager& manager) {
+    for (const auto& component : manager.GetMemoryUsage(0).components) {
+      if (component.name == "stops") {
+        return component.bytes;
+      }
+    }
+    return size_t{0};
+  };
+  TransportManager short_names{RoutingSettings{6, 40}};
+  TransportManager long_names{RoutingSettings{6, 40}};
+  short_names.AddStop("A", 55.6, 37.6, {});
+  long_names.AddStop(long_name, 55.6, 37.6, {});
+  ASSERT_EQUAL(stops_bytes(long_names), stops_bytes(short_names) + Memory::HeapBytes(long_name));
+}
+
+void TestTransportManager() {
+  TestRunner tr;
+  RUN_TEST(tr, TestRoadDistances);
+  RUN_TEST(tr, TestParetoRoutes);
+  RUN_TEST(tr, TestParetoRoutesMatchFastestRoute);
+  RUN_TEST(tr, TestRouteMatrix);
+  RUN_TEST(tr, TestIsochrone);
+  RUN_TEST(tr, TestRouteTimesMatchRoute);
+  RUN_TEST(tr, TestParallelIngestion);
+  RUN_TEST(tr, TestSpatialIndex);
+  RUN_TEST(tr, TestStopLookupsByCoordinates);
+  RUN_TEST(tr, TestTimedRoutes);
+  RUN_TEST(tr, TestTimedRoutesOnGridCity);
+  RUN_TEST(tr, TestBinaryFormat);
+  RUN_TEST(tr, TestMemoryUsage);
+}
@@ -0,0 +1,94 @@
+#include "timetable.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+const size_t NO_CONNECTION = numeric_limits<size_t>::max();
+const uint32_t NOT_BOARDED = numeric_limits<uint32_t>::max();
+
+}
+
+Timetable::Timetable(size_t stop_count, size_t trip_count, vector<Connection> connections)
+  : stop_count_(stop_count)
+  , trip_count_(trip_count)
+  , connections_(move(connections))
+  , last_arrival_(stop_count, -numeric_limits<double>::infinity())
+{
+  if (connections_.size() >= NOT_BOARDED) {
+    throw length_error("Too many connections");
+  }
+  for (const auto& connection : connections_) {
+    if (connection.from >= stop_count_ || connection.to >= stop_count_ || connection.trip >= trip_count_) {
+      throw out_of_range("Connection refers to an unknown stop or trip");
+    }
+    if (connection.arrival < connection.departure) {
+      throw invalid_argument("Connection arrives before it departs");
+    }
+    last_arrival_[connection.to] = max(last_arrival_[connection.to], connection.arrival);
+  }
+  // Hops of one trip sharing a departure time keep their order along the trip
+  sort(begin(connections_), end(connections_), [](const Connection& lhs, const Connection& rhs) {
+    return tie(lhs.departure, lhs.arrival, lhs.trip, lhs.position) < tie(rhs.departure, rhs.arrival, rhs.trip, rhs.position);
+  });
+}
+
+optional<Timetable::Journey> Timetable::FindEarliestArrival(StopId from, StopId to, double departure_time) const {
+  if (from >= stop_count_ || to >= stop_count_) {
+    return nullopt;
+  }
+  if (from == to) {
+    return Journey{departure_time, {}};
+  }
+
+  if (last_arrival_[to] < departure_time) {
+    return nullopt;
+  }
+
+  vector<double> earliest(stop_count_, numeric_limits<double>::infinity());
+  vector<Leg> last_leg(stop_count_, Leg{NO_CONNECTION, NO_CONNECTION});
+  vector<uint32_t> boarded(trip_count_, NOT_BOARDED);
+  earliest[from] = departure_time;
+  // No connection departing later can arrive at the target
+  const double scan_end = last_arrival_[to];
+
+  auto first = lower_bound(begin(connections_), end(connections_), departure_time,
+                           [](const Connection& connection, double time) { return connection.departure < time; });
+  for (auto it = first; it != end(connections_) && it->departure < earliest[to] && it->departure <= scan_end; ++it) {
+    const auto& connection = *it;
+    const auto id = static_cast<uint32_t>(it - begin(connections_));
+    if (boarded[connection.trip] == NOT_BOARDED) {
+      if (earliest[connection.from] > connection.departure) {
+        continue;
+      }
+      boarded[connection.trip] = id;
+    }
+    if (connection.arrival < earliest[connection.to]) {
+      earliest[connection.to] = connection.arrival;
+      last_leg[connection.to] = Leg{boarded[connection.trip], id};
+    }
+  }
+
+  if (last_leg[to].alight == NO_CONNECTION) {
+    return nullopt;
+  }
+
+  Journey journey{earliest[to], {}};
+  for (StopId stop = to; stop != from; stop = connections_[last_leg[stop].board].from) {
+    journey.legs.push_back(last_leg[stop]);
+  }
+  reverse(begin(journey.legs), end(journey.legs));
+  return journey;
+}
+
+size_t Timetable::HeapBytes() const {
+  return Memory::HeapBytes(connections_) + Memory::HeapBytes(last_arrival_);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "stop_manager.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Earliest arrival queries over timetabled departures with the connection
+// scan algorithm: every hop of every vehicle trip is a connection, they are
+// scanned once in departure order starting from the requested time, so a
+// query costs the number of connections departing before the arrival.
+// Times are minutes since midnight.
+class Timetable {
+public:
+  struct Connection {
+    StopId from;
+    StopId to;
+    double departure;
+    double arrival;
+    uint32_t trip;
+    uint32_t position;  // index of the hop within its trip
+  };
+
+  // Ride on one trip from connection board to connection alight inclusive
+  struct Leg {
+    size_t board;
+    size_t alight;
+  };
+
+  struct Journey {
+    double arrival;
+    std::vector<Leg> legs;
+  };
+
+  Timetable() = default;
+  Timetable(size_t stop_count, size_t trip_count, std::vector<Connection> connections);
+
+  size_t ConnectionCount() const { return connections_.size(); }
+  const Connection& GetConnection(size_t id) const { return connections_[id]; }
+  size_t HeapBytes() const;
+
+  std::optional<Journey> FindEarliestArrival(StopId from, StopId to, double departure_time) const;
+
+private:
+  size_t stop_count_{0};
+  size_t trip_count_{0};
+  std::vector<Connection> connections_;
+  std::vector<double> last_arrival_;  // per stop, bounds the scan for unreachable targets
+};
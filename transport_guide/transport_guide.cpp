@@ -1,6 +1,7 @@
 #include "bus.h"
 #include "transport_manager.h"
 
+#include "binary_format.h"
 #include "json_parser.h"
 #include "stop_manager.h"
 #include "transport_manager_command.h"
@@ -13,25 +14,14 @@
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <algorithm>
 
 using namespace std;
 
-void HandleInputCommand(TransportManager &manager, const InCommand *command) {
-  if (command->Type() == InCommandType::NEW_STOP) {
-    auto new_stop_command = dynamic_cast<const NewStopCommand *>(command);
-    manager.AddStop(new_stop_command->Name(), new_stop_command->Latitude(),
-                    new_stop_command->Longitude(),
-                    new_stop_command->Distances());
-  } else if (command->Type() == InCommandType::NEW_BUS) {
-    auto new_bus_command = dynamic_cast<const NewBusCommand *>(command);
-    manager.AddBus(new_bus_command->Name(), new_bus_command->Stops(),
-                   new_bus_command->IsCyclic());
-  } else {
-    throw std::invalid_argument("Unsupported command");
-  }
-}
-
-void HandleOutputCommand(TransportManager &manager, const OutCommand *command, vector<StopInfo>& stop_info_data, vector<BusInfo>& bus_info_data, vector<RouteInfo>& route_data) {
+void HandleOutputCommand(TransportManager &manager, const OutCommand *command, vector<StopInfo>& stop_info_data, vector<BusInfo>& bus_info_data, vector<RouteInfo>& route_data,
+                         vector<ParetoRouteInfo>& pareto_route_data, vector<RouteMatrixInfo>& route_matrix_data,
+                         vector<IsochroneInfo>& isochrone_data, vector<NearestStopsInfo>& nearest_stops_data,
+                         vector<StopsInBoxInfo>& stops_in_box_data, vector<MemoryUsageInfo>& memory_usage_data) {
   if (command->Type() == OutCommandType::STOP_DESCRIPTION) {
     auto stop_command = dynamic_cast<const StopDescriptionCommand *>(command);
     auto stop_info = manager.GetStopInfo(stop_command->Name(), stop_command->RequestId());
@@ -44,12 +34,94 @@ void HandleOutputCommand(TransportManager &manager, const OutCommand *command, v
     auto route_command = dynamic_cast<const RouteCommand*>(command);
     auto route_info = manager.GetRouteInfo(route_command->From(), route_command->To(), route_command->RequestId());
     route_data.push_back(move(route_info));
+  } else if (command->Type() == OutCommandType::PARETO_ROUTE) {
+    auto pareto_route_command = dynamic_cast<const ParetoRouteCommand*>(command);
+    auto pareto_route_info = manager.GetParetoRouteInfo(pareto_route_command->From(), pareto_route_command->To(),
+                                                        pareto_route_command->MaxRoutes(), pareto_route_command->RequestId());
+    pareto_route_data.push_back(move(pareto_route_info));
+  } else if (command->Type() == OutCommandType::ROUTE_MATRIX) {
+    auto route_matrix_command = dynamic_cast<const RouteMatrixCommand*>(command);
+    auto route_matrix = manager.GetRouteMatrix(route_matrix_command->From(), route_matrix_command->To(), route_matrix_command->RequestId());
+    route_matrix_data.push_back(move(route_matrix));
+  } else if (command->Type() == OutCommandType::ISOCHRONE) {
+    auto isochrone_command = dynamic_cast<const IsochroneCommand*>(command);
+    auto isochrone = manager.GetIsochrone(isochrone_command->From(), isochrone_command->MaxTime(), isochrone_command->RequestId());
+    isochrone_data.push_back(move(isochrone));
+  } else if (command->Type() == OutCommandType::NEAREST_STOPS) {
+    auto nearest_stops_command = dynamic_cast<const NearestStopsCommand*>(command);
+    auto nearest_stops = manager.GetNearestStops(Coordinates{nearest_stops_command->Latitude(), nearest_stops_command->Longitude()},
+                                                 nearest_stops_command->Count(), nearest_stops_command->RequestId());
+    nearest_stops_data.push_back(move(nearest_stops));
+  } else if (command->Type() == OutCommandType::STOPS_IN_BOX) {
+    auto stops_in_box_command = dynamic_cast<const StopsInBoxCommand*>(command);
+    auto stops_in_box = manager.GetStopsInBox(Coordinates{stops_in_box_command->MinLatitude(), stops_in_box_command->MinLongitude()},
+                                              Coordinates{stops_in_box_command->MaxLatitude(), stops_in_box_command->MaxLongitude()},
+                                              stops_in_box_command->RequestId());
+    stops_in_box_data.push_back(move(stops_in_box));
+  } else if (command->Type() == OutCommandType::MEMORY_USAGE) {
+    auto memory_usage_command = dynamic_cast<const MemoryUsageCommand*>(command);
+    memory_usage_data.push_back(manager.GetMemoryUsage(memory_usage_command->RequestId()));
+  } else if (command->Type() == OutCommandType::TIMED_ROUTE) {
+    auto route_command = dynamic_cast<const TimedRouteCommand*>(command);
+    auto route_info = manager.GetTimedRouteInfo(route_command->From(), route_command->To(),
+                                                route_command->DepartureTime(), route_command->RequestId());
+    route_data.push_back(move(route_info));
+  } else if (command->Type() == OutCommandType::ROUTE_FROM_POINT) {
+    auto route_command = dynamic_cast<const RouteFromPointCommand*>(command);
+    auto route_info = manager.GetRouteInfoFromPoint(Coordinates{route_command->Latitude(), route_command->Longitude()},
+                                                    route_command->To(), route_command->SnapCount(), route_command->RequestId());
+    route_data.push_back(move(route_info));
   } else {
     throw std::invalid_argument("Unsupported command");
   }
 }
 
-int main() {
+enum class OutputFormat {
+  JSON,
+  BINARY,
+};
+
+struct Options {
+  OutputFormat output_format{OutputFormat::JSON};
+  bool memory_report{false};
+  // Parallel ingestion was measured slower than the serial one on the
+  // inputs we have, so it stays opt-in until it scales
+  size_t ingest_threads{1};
+};
+
+Options ParseOptions(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const string_view argument = argv[i];
+    if (argument == "--format=json") {
+      options.output_format = OutputFormat::JSON;
+    } else if (argument == "--format=binary") {
+      options.output_format = OutputFormat::BINARY;
+    } else if (argument == "--memory-report") {
+      options.memory_report = true;
+    } else if (const string_view prefix = "--ingest-threads="; argument.substr(0, prefix.size()) == prefix) {
+      const string value{argument.substr(prefix.size())};
+      if (value.empty() || value.find_first_not_of("0123456789") != string::npos || stoul(value) == 0) {
+        throw invalid_argument("Bad thread count in " + string{argument});
+      }
+      options.ingest_threads = stoul(value);
+    } else {
+      throw invalid_argument("Unknown argument " + string{argument});
+    }
+  }
+  return options;
+}
+
+void PrintMemoryUsage(const MemoryUsageInfo& memory_usage, ostream& output) {
+  for (const auto& component : memory_usage.components) {
+    output << setw(20) << left << component.name << component.bytes << '\n';
+  }
+  output << setw(20) << left << "total" << memory_usage.total_bytes << endl;
+}
+
+int main(int argc, char* argv[]) {
+  const auto options = ParseOptions(argc, argv);
+
   //ifstream ifs{"input6"};
   //TransportManagerCommands commands = JsonArgs::ReadCommands(ifs);
   TransportManagerCommands commands = JsonArgs::ReadCommands(cin);
@@ -58,19 +130,37 @@ int main() {
     RoutingSettings{commands.routing_settings.bus_wait_time, commands.routing_settings.bus_velocity}
   };
 
-  for (const auto& command : commands.input_commands) {
-    HandleInputCommand(manager, command.get());
-  }
+  manager.AddBaseRequests(commands.input_commands, options.ingest_threads);
 
   manager.CreateRoutes();
+  if (options.memory_report) {
+    PrintMemoryUsage(manager.GetMemoryUsage(0), cerr);
+  }
 
   vector<StopInfo> stop_info_data;
   vector<BusInfo> bus_info_data;
   vector<RouteInfo> route_data;
+  vector<ParetoRouteInfo> pareto_route_data;
+  vector<RouteMatrixInfo> route_matrix_data;
+  vector<IsochroneInfo> isochrone_data;
+  vector<NearestStopsInfo> nearest_stops_data;
+  vector<StopsInBoxInfo> stops_in_box_data;
+  vector<MemoryUsageInfo> memory_usage_data;
 
   for (const auto& command : commands.output_commands) {
-    HandleOutputCommand(manager, command.get(), stop_info_data, bus_info_data, route_data);
+    HandleOutputCommand(manager, command.get(), stop_info_data, bus_info_data, route_data, pareto_route_data,
+                        route_matrix_data, isochrone_data, nearest_stops_data, stops_in_box_data, memory_usage_data);
+  }
+
+  if (options.output_format == OutputFormat::BINARY) {
+    if (!pareto_route_data.empty() || !route_matrix_data.empty() || !isochrone_data.empty()
+        || !nearest_stops_data.empty() || !stops_in_box_data.empty() || !memory_usage_data.empty()) {
+      throw invalid_argument("Binary output supports Stop, Bus and Route responses only");
+    }
+    BinaryArgs::PrintResults(stop_info_data, bus_info_data, route_data, cout);
+    return 0;
   }
 
-  JsonArgs::PrintResults(stop_info_data, bus_info_data, route_data, cout);
+  JsonArgs::PrintResults(stop_info_data, bus_info_data, route_data, pareto_route_data, route_matrix_data,
+                         isochrone_data, nearest_stops_data, stops_in_box_data, memory_usage_data, cout);
 }
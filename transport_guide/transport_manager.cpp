@@ -1,6 +1,7 @@
 #include "transport_manager.h"
 #include "bus.h"
 #include "graph.h"
+#include "memory_usage.h"
 #include "stop_manager.h"
 #include "transport_manager_command.h"
 
@@ -8,38 +9,276 @@
 #include <sstream>
 #include <set>
 #include <unordered_set>
+#include <variant>
 #include <memory>
+#include <optional>
 #include <algorithm>
+#include <future>
+#include <thread>
+#include <tuple>
+#include <utility>
 #include <iostream>
+#include <stdexcept>
+#include <string_view>
 #include <iomanip>
 
 using namespace std;
 
-void TransportManager::InitStop(const string& name) {
-  if (!stop_idx.count(name) || (stop_idx.count(name) && stops_[stop_idx[name]].Name() != name)) {
+namespace {
+
+// Splits [0, count) into at most chunk_count contiguous chunks and runs
+// f(chunk_index, begin, end) for each of them on its own thread
+template <typename F>
+void RunChunksInParallel(size_t count, size_t chunk_count, F f) {
+  chunk_count = max<size_t>(1, min(chunk_count, count));
+  if (chunk_count == 1) {
+    f(0, 0, count);
+    return;
+  }
+
+  const size_t chunk = (count + chunk_count - 1) / chunk_count;
+  vector<future<void>> futures;
+  for (size_t index = 0, begin = 0; begin < count; ++index, begin += chunk) {
+    futures.push_back(async(launch::async, f, index, begin, min(count, begin + chunk)));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
+// Runs f(begin, end) over [0, count) split into contiguous chunks, one per
+// hardware thread; small workloads stay on the calling thread
+template <typename F>
+void ParallelForChunks(size_t count, size_t min_chunk, F f) {
+  const size_t thread_count = min<size_t>(thread::hardware_concurrency(), count / max<size_t>(1, min_chunk));
+  RunChunksInParallel(count, thread_count, [&f](size_t, size_t begin, size_t end) { f(begin, end); });
+}
+
+// Position of a name in the input: chunk index and local id within the chunk
+using NameOccurrence = pair<size_t, StopId>;
+
+// Everything one thread collects from its chunk of base requests; stops are
+// numbered locally in order of their first occurrence within the chunk, and
+// the local ids are also bucketed by the shard of the name hash
+struct IngestChunk {
+  explicit IngestChunk(size_t shard_count) : shard_names(shard_count) {}
+
+  vector<const string*> stop_names;
+  unordered_map<string_view, StopId> local_ids;
+  vector<vector<StopId>> shard_names;
+  vector<tuple<StopId, StopId, unsigned int>> distances;
+  vector<pair<StopId, Coordinates>> coordinates;
+  vector<pair<const NewBusCommand*, vector<StopId>>> buses;
+  // First occurrence of every local name over all chunks, nullopt for names
+  // known before the requests
+  vector<optional<NameOccurrence>> first_occurrences;
+  vector<StopId> global_ids;
+
+  StopId Intern(const string& name) {
+    const auto [it, inserted] = local_ids.try_emplace(name, stop_names.size());
+    if (inserted) {
+      stop_names.push_back(&name);
+      shard_names[hash<string_view>{}(name) % shard_names.size()].push_back(it->second);
+    }
+    return it->second;
+  }
+
+  bool IsFirstOccurrence(size_t index, StopId local_id) const {
+    return first_occurrences[local_id] == NameOccurrence{index, local_id};
+  }
+};
+
+}
+
+StopId TransportManager::InitStop(const string& name) {
+  const auto [it, inserted] = stop_idx.try_emplace(name, stops_.size());
+  if (inserted) {
     stops_.emplace_back(name);
-    stop_idx[name] = stops_.size() - 1;
   }
+  return static_cast<StopId>(it->second);
 }
 
-void TransportManager::AddStop(const string& name, double latitude, double longitude, const unordered_map<string, unsigned int>& distances) {
-  InitStop(name);
+void TransportManager::FreezeDistances() {
+  if (!distances_.IsFrozen()) {
+    distances_.Freeze(stops_.size());
+  }
+}
 
-  size_t id = stop_idx[name];
+void TransportManager::AddStop(const string& name, double latitude, double longitude, const unordered_map<string, unsigned int>& distances) {
+  const StopId id = InitStop(name);
   stops_[id].SetCoordinates(Coordinates{latitude, longitude});
 
   for (const auto& [stop_name, dist] : distances) {
-    InitStop(stop_name);
-    distances_[id][stop_idx[stop_name]] = dist;
-    if (!distances_[stop_idx[stop_name]].count(id) || (distances_[stop_idx[stop_name]].count(id) && distances_[stop_idx[stop_name]][id] == 0)) {
-      distances_[stop_idx[stop_name]][id] = dist;
+    distances_.Add(id, InitStop(stop_name), dist);
+  }
+}
+
+void TransportManager::AddBaseRequests(const vector<unique_ptr<InCommand>>& commands, size_t thread_count) {
+  if (thread_count <= 1) {
+    for (const auto& command : commands) {
+      if (command->Type() == InCommandType::NEW_STOP) {
+        auto new_stop_command = dynamic_cast<const NewStopCommand*>(command.get());
+        AddStop(new_stop_command->Name(), new_stop_command->Latitude(),
+                new_stop_command->Longitude(), new_stop_command->Distances());
+      } else if (command->Type() == InCommandType::NEW_BUS) {
+        auto new_bus_command = dynamic_cast<const NewBusCommand*>(command.get());
+        AddBus(new_bus_command->Name(), new_bus_command->Stops(), new_bus_command->IsCyclic(), new_bus_command->Intervals());
+      } else {
+        throw std::invalid_argument("Unsupported command");
+      }
+    }
+    return;
+  }
+
+  // Phase 1: every thread interns names and collects distances of its chunk
+  vector<IngestChunk> chunks(thread_count, IngestChunk(thread_count));
+  RunChunksInParallel(commands.size(), thread_count, [&commands, &chunks](size_t index, size_t begin, size_t end) {
+    auto& chunk = chunks[index];
+    for (size_t i = begin; i < end; ++i) {
+      const InCommand* command = commands[i].get();
+      if (command->Type() == InCommandType::NEW_STOP) {
+        auto new_stop_command = dynamic_cast<const NewStopCommand*>(command);
+        const StopId id = chunk.Intern(new_stop_command->Name());
+        chunk.coordinates.emplace_back(id, Coordinates{new_stop_command->Latitude(), new_stop_command->Longitude()});
+        for (const auto& [stop_name, dist] : new_stop_command->Distances()) {
+          chunk.distances.emplace_back(id, chunk.Intern(stop_name), dist);
+        }
+      } else if (command->Type() == InCommandType::NEW_BUS) {
+        auto new_bus_command = dynamic_cast<const NewBusCommand*>(command);
+        vector<StopId> stops;
+        stops.reserve(new_bus_command->Stops().size());
+        for (const auto& stop_name : new_bus_command->Stops()) {
+          stops.push_back(chunk.Intern(stop_name));
+        }
+        chunk.buses.emplace_back(new_bus_command, move(stops));
+      } else {
+        throw std::invalid_argument("Unsupported command");
+      }
+    }
+  });
+
+  // Phase 2: names are merged by shards of their hashes in parallel; every
+  // shard walks its names of all chunks in order and finds the first
+  // occurrence of each of them
+  const size_t shard_count = thread_count;
+  for (auto& chunk : chunks) {
+    chunk.first_occurrences.resize(chunk.stop_names.size());
+    chunk.global_ids.resize(chunk.stop_names.size());
+  }
+  RunChunksInParallel(shard_count, shard_count, [this, &chunks](size_t, size_t begin, size_t end) {
+    for (size_t shard = begin; shard < end; ++shard) {
+      unordered_map<string_view, NameOccurrence> first_occurrences;
+      for (size_t index = 0; index < chunks.size(); ++index) {
+        auto& chunk = chunks[index];
+        for (StopId local_id : chunk.shard_names[shard]) {
+          const string& name = *chunk.stop_names[local_id];
+          if (auto it = stop_idx.find(name); it != stop_idx.end()) {
+            chunk.global_ids[local_id] = static_cast<StopId>(it->second);
+          } else {
+            chunk.first_occurrences[local_id] = first_occurrences.try_emplace(name, index, local_id).first->second;
+          }
+        }
+      }
+    }
+  });
+
+  // New names get ids in order of their first occurrences, as InitStop would
+  // give them, so every chunk starts after the new names of the previous ones
+  vector<StopId> first_new_ids(chunks.size());
+  RunChunksInParallel(chunks.size(), thread_count, [&chunks, &first_new_ids](size_t, size_t begin, size_t end) {
+    for (size_t index = begin; index < end; ++index) {
+      for (StopId local_id = 0; local_id < chunks[index].stop_names.size(); ++local_id) {
+        first_new_ids[index] += chunks[index].IsFirstOccurrence(index, local_id);
+      }
+    }
+  });
+  StopId next_id = static_cast<StopId>(stops_.size());
+  for (auto& first_id : first_new_ids) {
+    next_id += exchange(first_id, next_id);
+  }
+
+  RunChunksInParallel(chunks.size(), thread_count, [&chunks, &first_new_ids](size_t, size_t begin, size_t end) {
+    for (size_t index = begin; index < end; ++index) {
+      auto& chunk = chunks[index];
+      StopId next_id = first_new_ids[index];
+      for (StopId local_id = 0; local_id < chunk.stop_names.size(); ++local_id) {
+        if (chunk.IsFirstOccurrence(index, local_id)) {
+          chunk.global_ids[local_id] = next_id++;
+        }
+      }
+    }
+  });
+  // Ids of the first occurrences are all known now
+  RunChunksInParallel(chunks.size(), thread_count, [&chunks](size_t, size_t begin, size_t end) {
+    for (size_t index = begin; index < end; ++index) {
+      auto& chunk = chunks[index];
+      for (StopId local_id = 0; local_id < chunk.stop_names.size(); ++local_id) {
+        if (const auto& first = chunk.first_occurrences[local_id]) {
+          chunk.global_ids[local_id] = chunks[first->first].global_ids[first->second];
+        }
+      }
+    }
+  });
+
+  // Only the inserts into the single stop index and the distance records stay
+  // serial: one insert per new name, and the records in input order
+  stops_.reserve(next_id);
+  stop_idx.reserve(next_id);
+  for (size_t index = 0; index < chunks.size(); ++index) {
+    const auto& chunk = chunks[index];
+    for (StopId local_id = 0; local_id < chunk.stop_names.size(); ++local_id) {
+      if (chunk.IsFirstOccurrence(index, local_id)) {
+        stops_.emplace_back(*chunk.stop_names[local_id]);
+        stop_idx.emplace(*chunk.stop_names[local_id], chunk.global_ids[local_id]);
+      }
+    }
+  }
+  for (const auto& chunk : chunks) {
+    for (const auto& [from, to, dist] : chunk.distances) {
+      distances_.Add(chunk.global_ids[from], chunk.global_ids[to], dist);
+    }
+    for (const auto& [id, coordinates] : chunk.coordinates) {
+      stops_[chunk.global_ids[id]].SetCoordinates(coordinates);
+    }
+  }
+
+  // Phase 3: buses are built in parallel and inserted in input order
+  vector<vector<BusRoute>> chunk_routes(chunks.size());
+  RunChunksInParallel(chunks.size(), thread_count, [&chunks, &chunk_routes](size_t, size_t begin, size_t end) {
+    for (size_t index = begin; index < end; ++index) {
+      auto& chunk = chunks[index];
+      chunk_routes[index].reserve(chunk.buses.size());
+      for (auto& [command, stops] : chunk.buses) {
+        for (auto& stop : stops) {
+          stop = chunk.global_ids[stop];
+        }
+        chunk_routes[index].push_back(command->IsCyclic() ? BusRoute::CreateCyclicBusRoute(command->Name(), move(stops))
+                                                          : BusRoute::CreateRawBusRoute(command->Name(), move(stops)));
+        chunk_routes[index].back().SetIntervals(command->Intervals());
+      }
+    }
+  });
+
+  for (auto& routes : chunk_routes) {
+    for (auto& route : routes) {
+      auto route_number = route.Number();
+      buses_[route_number] = move(route);
     }
   }
 }
 
-void TransportManager::AddBus(const RouteNumber& bus_no, const std::vector<std::string>& stop_names, bool cyclic) {
-  buses_[string{bus_no}] = cyclic ? BusRoute::CreateCyclicBusRoute(bus_no, stop_names)
-    : BusRoute::CreateRawBusRoute(bus_no, stop_names);
+void TransportManager::AddBus(const RouteNumber& bus_no, const std::vector<std::string>& stop_names, bool cyclic,
+                              vector<BusInterval> intervals) {
+  vector<StopId> stops;
+  stops.reserve(stop_names.size());
+  for (const auto& stop_name : stop_names) {
+    stops.push_back(InitStop(stop_name));
+  }
+
+  auto route = cyclic ? BusRoute::CreateCyclicBusRoute(bus_no, move(stops))
+    : BusRoute::CreateRawBusRoute(bus_no, move(stops));
+  route.SetIntervals(move(intervals));
+  buses_[string{bus_no}] = move(route);
 }
 
 std::pair<unsigned int, double> TransportManager::ComputeBusRouteLength(const RouteNumber& route_number) {
@@ -53,16 +292,12 @@ std::pair<unsigned int, double> TransportManager::ComputeBusRouteLength(const Ro
 
   unsigned int distance_road{0};
   double distance_direct{0.0};
-  vector<const Stop*> bus_stops;
-  for (const auto& stop_name : buses_[route_number].Stops()) {
-    InitStop(stop_name);
-    bus_stops.push_back(&stops_[stop_idx[stop_name]]);
-  }
-
-  for (size_t i = 0; i < bus_stops.size() - 1; ++i) {
-    distance_direct += Coordinates::Distance(bus_stops[i]->StopCoordinates(),
-                                             bus_stops[i + 1]->StopCoordinates());
-    distance_road += distances_[stop_idx[bus_stops[i]->Name()]][stop_idx[bus_stops[i + 1]->Name()]];
+  FreezeDistances();
+  const auto bus_stops = buses_[route_number].Stops();
+  for (size_t i = 0; i + 1 < bus_stops.size(); ++i) {
+    distance_direct += Coordinates::Distance(stops_[bus_stops[i]].StopCoordinates(),
+                                             stops_[bus_stops[i + 1]].StopCoordinates());
+    distance_road += distances_.Get(bus_stops[i], bus_stops[i + 1]);
   }
 
   buses_[route_number].SetRouteLength(distance_road, distance_direct);
@@ -77,9 +312,10 @@ StopInfo TransportManager::GetStopInfo(const string& stop_name, size_t request_i
     };
   }
 
+  const auto stop_id = static_cast<StopId>(stop_idx.at(stop_name));
   set<RouteNumber> buses_with_stop;
   for (const auto& bus : buses_) {
-    if (bus.second.ContainsStop(stop_name)) {
+    if (bus.second.ContainsStop(stop_id)) {
         buses_with_stop.insert(bus.first);
     }
   }
@@ -111,68 +347,451 @@ BusInfo TransportManager::GetBusInfo(const RouteNumber& bus_no, size_t request_i
 }
 
 void TransportManager::CreateRoutes() {
-  road_graph = make_unique<Graph::DirectedWeightedGraph<double>>(2 * stops_.size());
+  FreezeDistances();
+
+  vector<SpatialIndex::Point> points;
+  points.reserve(stops_.size());
+  for (size_t i = 0; i < stops_.size(); ++i) {
+    points.push_back({static_cast<StopId>(i), stops_[i].StopCoordinates()});
+  }
+  stop_index_ = SpatialIndex(move(points));
+  road_graph = make_unique<RoadGraph>(2 * stops_.size());
 
   for (size_t i = 0; i < stops_.size(); ++i) {
-    road_graph->AddEdge(Graph::Edge<double>{
-        .from = 2 * i,
-        .to = 2 * i + 1,
-        .weight = static_cast<double>(routing_settings_.bus_wait_time),
+    road_graph->AddEdge(Graph::Edge<RouteWeight, GraphId>{
+        .from = static_cast<GraphId>(2 * i),
+        .to = static_cast<GraphId>(2 * i + 1),
+        .weight = static_cast<RouteWeight>(routing_settings_.bus_wait_time),
     });
-    edge_description.push_back(WaitActivity{
-      .type = "Wait",
-      .time = routing_settings_.bus_wait_time,
-      .stop_name = stops_[i].Name(),
+    edge_description.push_back(EdgeDescription{
+      .kind = EdgeDescription::Kind::WAIT,
+      .id = static_cast<uint32_t>(i),
+      .first_stop = 0,
+      .span_count = 0,
     });
   }
 
+  routes_.reserve(buses_.size());
   for (const auto& [bus_no, bus] : buses_) {
-    const auto& bus_stops = bus.Stops();
+    const auto route_id = static_cast<uint32_t>(routes_.size());
+    routes_.push_back(&bus);
+    const auto bus_stops = bus.Stops();
     for (size_t i = 0; i < bus_stops.size(); ++i) {
       double time_sum{0.0};
       unsigned int span_count{0};
       for (size_t j = i + 1; j < bus_stops.size(); ++j) {
-        time_sum += distances_[stop_idx[bus_stops[j - 1]]][stop_idx[bus_stops[j]]] / (routing_settings_.bus_velocity * 1000 / 60);
-        road_graph->AddEdge(Graph::Edge<double>{
-            .from = 2 * stop_idx[bus_stops[i]] + 1,
-            .to = 2 * stop_idx[bus_stops[j]],
-            .weight = time_sum
+        time_sum += ComputeTravelTime(bus_stops[j - 1], bus_stops[j]);
+        road_graph->AddEdge(Graph::Edge<RouteWeight, GraphId>{
+            .from = static_cast<GraphId>(2 * bus_stops[i] + 1),
+            .to = static_cast<GraphId>(2 * bus_stops[j]),
+            .weight = static_cast<RouteWeight>(time_sum),
         });
-        edge_description.push_back(BusActivity{
-          .type = "Bus",
-          .time = time_sum,
-          .bus = bus_no,
+        edge_description.push_back(EdgeDescription{
+          .kind = EdgeDescription::Kind::BUS,
+          .id = route_id,
+          .first_stop = static_cast<uint32_t>(i),
           .span_count = ++span_count,
         });
       }
     }
   }
 
-  router = make_unique<Graph::Router<double>>(*road_graph);
+  edge_times_.reserve(edge_description.size());
+  for (size_t edge_id = 0; edge_id < edge_description.size(); ++edge_id) {
+    edge_times_.push_back(ComputeEdgeTime(edge_id));
+  }
+  router = make_unique<Graph::Router<RouteWeight, GraphId>>(*road_graph);
+
+  // Every boarding goes through a wait edge, so counting them counts transfers + 1
+  vector<Graph::ParetoRouter<RouteWeight, GraphId>::Cost> boardings(edge_description.size());
+  for (size_t edge_id = 0; edge_id < edge_description.size(); ++edge_id) {
+    boardings[edge_id] = edge_description[edge_id].kind == EdgeDescription::Kind::WAIT;
+  }
+  pareto_router = make_unique<Graph::ParetoRouter<RouteWeight, GraphId>>(*road_graph, move(boardings));
+
+  CreateTimetable();
+}
+
+void TransportManager::CreateTimetable() {
+  vector<Timetable::Connection> connections;
+  trip_routes_.clear();
+  for (size_t route_id = 0; route_id < routes_.size(); ++route_id) {
+    const auto& bus = *routes_[route_id];
+    const auto bus_stops = bus.Stops();
+    if (bus_stops.size() < 2 || bus.Intervals().empty()) {
+      continue;
+    }
+
+    vector<double> offsets(bus_stops.size(), 0.0);
+    for (size_t i = 1; i < bus_stops.size(); ++i) {
+      offsets[i] = offsets[i - 1] + ComputeTravelTime(bus_stops[i - 1], bus_stops[i]);
+    }
+
+    for (const auto& interval : bus.Intervals()) {
+      for (size_t k = 0; interval.start + k * interval.interval < interval.end; ++k) {
+        const double start = interval.start + k * interval.interval;
+        const auto trip = static_cast<uint32_t>(trip_routes_.size());
+        trip_routes_.push_back(static_cast<uint32_t>(route_id));
+        for (size_t i = 0; i + 1 < bus_stops.size(); ++i) {
+          connections.push_back(Timetable::Connection{
+            .from = bus_stops[i],
+            .to = bus_stops[i + 1],
+            .departure = start + offsets[i],
+            .arrival = start + offsets[i + 1],
+            .trip = trip,
+            .position = static_cast<uint32_t>(i),
+          });
+        }
+      }
+    }
+  }
+
+  timetable_ = Timetable(stops_.size(), trip_routes_.size(), move(connections));
+}
+
+double TransportManager::ComputeTravelTime(StopId from, StopId to) const {
+  return distances_.Get(from, to) / (routing_settings_.bus_velocity * 1000 / 60);
+}
+
+double TransportManager::ComputeEdgeTime(GraphId edge_id) const {
+  const auto& description = edge_description[edge_id];
+  if (description.kind == EdgeDescription::Kind::WAIT) {
+    return routing_settings_.bus_wait_time;
+  }
+
+  const auto bus_stops = routes_[description.id]->Stops();
+  double time_sum{0.0};
+  for (size_t j = description.first_stop + 1; j <= description.first_stop + description.span_count; ++j) {
+    time_sum += ComputeTravelTime(bus_stops[j - 1], bus_stops[j]);
+  }
+  return time_sum;
+}
+
+TransportManager::RouteTimes::RouteTimes(size_t vertex_count) : times(vertex_count) {}
+
+void TransportManager::RouteTimes::Reset(GraphId from) {
+  for (auto vertex : summed) {
+    times[vertex].reset();
+  }
+  summed.clear();
+  from_vertex = from;
+  times[from] = 0.0;
+  summed.push_back(from);
+}
+
+optional<double> TransportManager::ComputeRouteTime(RouteTimes& route_times, GraphId to_vertex) const {
+  if (!router->GetRouteWeight(route_times.from_vertex, to_vertex)) {
+    return nullopt;
+  }
+
+  auto& times = route_times.times;
+  auto& pending_edges = route_times.pending_edges;
+  for (GraphId vertex = to_vertex; !times[vertex];) {
+    const GraphId edge_id = *router->GetLastRouteEdge(route_times.from_vertex, vertex);
+    pending_edges.push_back(edge_id);
+    vertex = road_graph->GetEdge(edge_id).from;
+  }
+  for (; !pending_edges.empty(); pending_edges.pop_back()) {
+    const auto& edge = road_graph->GetEdge(pending_edges.back());
+    times[edge.to] = *times[edge.from] + edge_times_[pending_edges.back()];
+    route_times.summed.push_back(edge.to);
+  }
+  return times[to_vertex];
+}
+
+variant<WaitActivity, BusActivity> TransportManager::DescribeEdge(GraphId edge_id) const {
+  const auto& description = edge_description[edge_id];
+  if (description.kind == EdgeDescription::Kind::WAIT) {
+    return WaitActivity{
+      .type = "Wait",
+      .time = edge_times_[edge_id],
+      .stop_name = stops_[description.id].Name(),
+    };
+  }
+
+  return BusActivity{
+    .type = "Bus",
+    .time = ComputeEdgeTime(edge_id),
+    .bus = routes_[description.id]->Number(),
+    .span_count = description.span_count,
+  };
+}
+
+double TransportManager::DescribeEdges(const vector<GraphId>& edges, vector<variant<WaitActivity, BusActivity>>& items) const {
+  double total_time{0.0};
+  items.reserve(items.size() + edges.size());
+  for (auto edge_id : edges) {
+    items.push_back(DescribeEdge(edge_id));
+    total_time += visit([](const auto& activity) -> double { return activity.time; }, items.back());
+  }
+  return total_time;
+}
+
+RouteInfo TransportManager::GetRouteInfo(std::string from, std::string to, size_t request_id) {
+  return BuildRouteInfo(2 * stop_idx[from], 2 * stop_idx[to], request_id);
+}
+
+RouteInfo TransportManager::BuildRouteInfo(GraphId from_vertex, GraphId to_vertex, size_t request_id) {
+  auto route_info = router->BuildRoute(from_vertex, to_vertex);
+
+  if (!route_info.has_value()) {
+    return {
+      .request_id = request_id,
+      .error_message = "not found",
+    };
+  }
+
+  vector<GraphId> edges;
+  edges.reserve(route_info.value().edge_count);
+  auto id = route_info.value().id;
+  for (size_t i = 0; i < route_info.value().edge_count; ++i) {
+    edges.push_back(router->GetRouteEdge(id, i));
+  }
+  router->ReleaseRoute(id);
+
+  std::vector<std::variant<WaitActivity, BusActivity>> items;
+  const double total_time = DescribeEdges(edges, items);
+
+  return {
+    .request_id = request_id,
+    .total_time = total_time,
+    .items = move(items),
+  };
+}
+
+ParetoRouteInfo TransportManager::GetParetoRouteInfo(const string& from, const string& to, size_t max_routes, size_t request_id) {
+  if (!stop_idx.count(from) || !stop_idx.count(to)) {
+    return {
+      .request_id = request_id,
+      .error_message = "not found",
+    };
+  }
+
+  auto routes = pareto_router->BuildRoutes(2 * stop_idx.at(from), 2 * stop_idx.at(to), max_routes);
+  if (routes.empty()) {
+    return {
+      .request_id = request_id,
+      .error_message = "not found",
+    };
+  }
+
+  vector<RouteOption> options;
+  options.reserve(routes.size());
+  for (const auto& route : routes) {
+    vector<variant<WaitActivity, BusActivity>> items;
+    const double total_time = DescribeEdges(route.edges, items);
+    options.push_back(RouteOption{
+      .total_time = total_time,
+      .transfer_count = route.cost > 0 ? route.cost - 1 : 0,
+      .items = move(items),
+    });
+  }
+
+  return {
+    .request_id = request_id,
+    .routes = move(options),
+  };
+}
+
+RouteMatrixInfo TransportManager::GetRouteMatrix(const vector<string>& from, const vector<string>& to, size_t request_id) const {
+  auto resolve_stops = [this](const vector<string>& names, vector<GraphId>& vertices) {
+    vertices.reserve(names.size());
+    for (const auto& name : names) {
+      auto it = stop_idx.find(name);
+      if (it == stop_idx.end()) {
+        return false;
+      }
+      vertices.push_back(2 * it->second);
+    }
+    return true;
+  };
+
+  vector<GraphId> from_vertices;
+  vector<GraphId> to_vertices;
+  if (!resolve_stops(from, from_vertices) || !resolve_stops(to, to_vertices)) {
+    return {
+      .request_id = request_id,
+      .column_count = to.size(),
+      .error_message = "not found",
+    };
+  }
+
+  vector<optional<double>> total_times(from.size() * to.size());
+  ParallelForChunks(from.size(), 4096 / max<size_t>(1, to.size()) + 1, [&](size_t row_begin, size_t row_end) {
+    RouteTimes route_times(road_graph->GetVertexCount());
+    for (size_t row = row_begin; row < row_end; ++row) {
+      route_times.Reset(from_vertices[row]);
+      for (size_t column = 0; column < to_vertices.size(); ++column) {
+        total_times[row * to_vertices.size() + column] = ComputeRouteTime(route_times, to_vertices[column]);
+      }
+    }
+  });
+
+  return {
+    .request_id = request_id,
+    .column_count = to.size(),
+    .total_times = move(total_times),
+  };
 }
 
-  RouteInfo TransportManager::GetRouteInfo(std::string from, std::string to, size_t request_id) {
-    size_t from_id = 2 * stop_idx[from];
-    size_t to_id = 2 * stop_idx[to];
-    auto route_info = router->BuildRoute(from_id, to_id);
+IsochroneInfo TransportManager::GetIsochrone(const string& from, double max_time, size_t request_id) const {
+  auto it = stop_idx.find(from);
+  if (it == stop_idx.end()) {
+    return {
+      .request_id = request_id,
+      .error_message = "not found",
+    };
+  }
 
-    if (!route_info.has_value()) {
-      return {
-        .request_id = request_id,
-        .error_message = "not found",
-      };
+  const GraphId from_vertex = 2 * it->second;
+  vector<optional<double>> total_times(stops_.size());
+  ParallelForChunks(stops_.size(), 4096, [&](size_t stop_begin, size_t stop_end) {
+    RouteTimes route_times(road_graph->GetVertexCount());
+    route_times.Reset(from_vertex);
+    for (size_t stop_id = stop_begin; stop_id < stop_end; ++stop_id) {
+      total_times[stop_id] = ComputeRouteTime(route_times, 2 * stop_id);
     }
+  });
 
-    std::vector<std::variant<WaitActivity, BusActivity>> items;
-    auto id = route_info.value().id;
-    for (size_t i = 0; i < route_info.value().edge_count; ++i) {
-      auto edge_id = router->GetRouteEdge(id, i);
-      items.push_back(edge_description[edge_id]);
+  vector<ReachableStop> reachable;
+  for (size_t stop_id = 0; stop_id < stops_.size(); ++stop_id) {
+    if (total_times[stop_id] && *total_times[stop_id] <= max_time) {
+      reachable.push_back({stops_[stop_id].Name(), *total_times[stop_id]});
     }
+  }
+  sort(begin(reachable), end(reachable), [](const ReachableStop& lhs, const ReachableStop& rhs) {
+    return tie(lhs.total_time, lhs.stop_name) < tie(rhs.total_time, rhs.stop_name);
+  });
 
+  return {
+    .request_id = request_id,
+    .stops = move(reachable),
+  };
+}
+
+NearestStopsInfo TransportManager::GetNearestStops(Coordinates point, size_t count, size_t request_id) const {
+  vector<NearbyStop> nearby;
+  for (const auto& neighbour : stop_index_.FindNearest(point, count)) {
+    nearby.push_back({stops_[neighbour.id].Name(), neighbour.distance});
+  }
+  return {
+    .request_id = request_id,
+    .stops = move(nearby),
+  };
+}
+
+StopsInBoxInfo TransportManager::GetStopsInBox(Coordinates min_corner, Coordinates max_corner, size_t request_id) const {
+  vector<string> names;
+  for (auto id : stop_index_.FindInBox(min_corner, max_corner)) {
+    names.push_back(stops_[id].Name());
+  }
+  sort(begin(names), end(names));
+  return {
+    .request_id = request_id,
+    .stops = move(names),
+  };
+}
+
+RouteInfo TransportManager::GetRouteInfoFromPoint(Coordinates from, const string& to, size_t snap_count, size_t request_id) {
+  auto to_it = stop_idx.find(to);
+  if (to_it == stop_idx.end()) {
+    return {
+      .request_id = request_id,
+      .error_message = "not found",
+    };
+  }
+
+  const GraphId to_vertex = 2 * to_it->second;
+  optional<pair<double, GraphId>> best;
+  RouteTimes route_times(road_graph->GetVertexCount());
+  for (const auto& neighbour : stop_index_.FindNearest(from, snap_count)) {
+    const GraphId from_vertex = 2 * neighbour.id;
+    route_times.Reset(from_vertex);
+    if (auto total_time = ComputeRouteTime(route_times, to_vertex); total_time && (!best || *total_time < best->first)) {
+      best = {*total_time, from_vertex};
+    }
+  }
+
+  if (!best) {
+    return {
+      .request_id = request_id,
+      .error_message = "not found",
+    };
+  }
+  return BuildRouteInfo(best->second, to_vertex, request_id);
+}
+
+RouteInfo TransportManager::GetTimedRouteInfo(const string& from, const string& to, double departure_time, size_t request_id) const {
+  auto from_it = stop_idx.find(from);
+  auto to_it = stop_idx.find(to);
+  if (from_it == stop_idx.end() || to_it == stop_idx.end()) {
+    return {
+      .request_id = request_id,
+      .error_message = "not found",
+    };
+  }
+
+  auto journey = timetable_.FindEarliestArrival(from_it->second, to_it->second, departure_time);
+  if (!journey) {
     return {
       .request_id = request_id,
-      .total_time = route_info.value().weight,
-      .items = items,
+      .error_message = "not found",
     };
   }
+
+  vector<variant<WaitActivity, BusActivity>> items;
+  items.reserve(2 * journey->legs.size());
+  double ready_time = departure_time;
+  for (const auto& leg : journey->legs) {
+    const auto& board = timetable_.GetConnection(leg.board);
+    const auto& alight = timetable_.GetConnection(leg.alight);
+    items.push_back(WaitActivity{
+      .type = "Wait",
+      .time = board.departure - ready_time,
+      .stop_name = stops_[board.from].Name(),
+    });
+    items.push_back(BusActivity{
+      .type = "Bus",
+      .time = alight.arrival - board.departure,
+      .bus = routes_[trip_routes_[board.trip]]->Number(),
+      .span_count = alight.position - board.position + 1,
+    });
+    ready_time = alight.arrival;
+  }
+
+  return {
+    .request_id = request_id,
+    .total_time = journey->arrival - departure_time,
+    .items = move(items),
+  };
+}
+
+MemoryUsageInfo TransportManager::GetMemoryUsage(size_t request_id) const {
+  auto owned_bytes = [](const auto& pointer) -> size_t {
+    return pointer ? Memory::TotalBytes(*pointer) : 0;
+  };
+
+  vector<MemoryComponent> components{
+    {"stops", Memory::TotalBytes(stops_)},
+    {"stop_names", Memory::TotalBytes(stop_idx)},
+    {"distances", Memory::TotalBytes(distances_)},
+    {"buses", Memory::TotalBytes(buses_)},
+    {"routes", Memory::TotalBytes(routes_)},
+    {"edge_description", Memory::TotalBytes(edge_description) + Memory::TotalBytes(edge_times_)},
+    {"road_graph", sizeof(road_graph) + owned_bytes(road_graph)},
+    {"router", sizeof(router) + owned_bytes(router)},
+    {"pareto_router", sizeof(pareto_router) + owned_bytes(pareto_router)},
+    {"spatial_index", Memory::TotalBytes(stop_index_)},
+    {"timetable", Memory::TotalBytes(timetable_) + Memory::TotalBytes(trip_routes_)},
+  };
+
+  size_t total_bytes = 0;
+  for (const auto& component : components) {
+    total_bytes += component.bytes;
+  }
+  return {
+    .request_id = request_id,
+    .components = move(components),
+    .total_bytes = total_bytes,
+  };
+}
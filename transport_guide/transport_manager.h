@@ -2,10 +2,16 @@
 
 #include "stop_manager.h"
 #include "bus.h"
+#include "road_distances.h"
+#include "spatial_index.h"
+#include "timetable.h"
 #include "transport_manager_command.h"
 #include "graph.h"
 #include "router.h"
+#include "pareto_router.h"
 
+#include <cstdint>
+#include <optional>
 #include <string_view>
 #include <variant>
 #include <vector>
@@ -18,17 +24,44 @@ struct RoutingSettings{
   double bus_velocity;
 };
 
+// Compact per-edge description of the routing graph: names and times are
+// resolved from stops_ and routes_ only when a route response is materialized.
+struct EdgeDescription {
+  enum class Kind : uint8_t {
+    WAIT,
+    BUS,
+  };
+
+  Kind kind;
+  uint32_t id;          // stop index for WAIT, route index for BUS
+  uint32_t first_stop;  // position of the boarding stop in the route for BUS
+  uint32_t span_count;
+};
+
 class TransportManager {
 public:
   using RouteNumber = BusRoute::RouteNumber;
 
+  // 32-bit ids and float weights halve the bytes moved by the routers;
+  // response times are recomputed in double from the road distances
+  using GraphId = uint32_t;
+  using RouteWeight = float;
+  using RoadGraph = Graph::DirectedWeightedGraph<RouteWeight, GraphId>;
+
   TransportManager(RoutingSettings routing_settings)
     : routing_settings_(std::move(routing_settings))
   {
   }
 
   void AddStop(const std::string& name, double latitude, double longitude, const std::unordered_map<std::string, unsigned int>& distances);
-  void AddBus(const RouteNumber& route_number, const std::vector<std::string>& stop_names, bool cyclic);
+  void AddBus(const RouteNumber& route_number, const std::vector<std::string>& stop_names, bool cyclic,
+              std::vector<BusInterval> intervals = {});
+  // Applies base requests in order; with several threads stop names are
+  // interned and distances collected per chunk of requests, the chunk name
+  // tables are merged by shards of the name hash and buses are built in
+  // parallel, which gives the same state as one thread. The stop index gets
+  // one serial insert per new name
+  void AddBaseRequests(const std::vector<std::unique_ptr<InCommand>>& commands, size_t thread_count);
 
   std::pair<unsigned int, double> ComputeBusRouteLength(const RouteNumber& route_number);
   StopInfo GetStopInfo(const std::string& stop_name, size_t request_id);
@@ -36,16 +69,57 @@ public:
 
   void CreateRoutes();
   RouteInfo GetRouteInfo(std::string from, std::string to, size_t request_id);
+  ParetoRouteInfo GetParetoRouteInfo(const std::string& from, const std::string& to, size_t max_routes, size_t request_id);
+  RouteMatrixInfo GetRouteMatrix(const std::vector<std::string>& from, const std::vector<std::string>& to, size_t request_id) const;
+  IsochroneInfo GetIsochrone(const std::string& from, double max_time, size_t request_id) const;
+
+  NearestStopsInfo GetNearestStops(Coordinates point, size_t count, size_t request_id) const;
+  StopsInBoxInfo GetStopsInBox(Coordinates min_corner, Coordinates max_corner, size_t request_id) const;
+  // Route from the best of the snap_count stops nearest to the point
+  RouteInfo GetRouteInfoFromPoint(Coordinates from, const std::string& to, size_t snap_count, size_t request_id);
+  // Earliest arrival when leaving at departure_time (minutes since midnight)
+  // by the buses with intervals; buses without them have no timetable
+  RouteInfo GetTimedRouteInfo(const std::string& from, const std::string& to, double departure_time, size_t request_id) const;
+
+  // Bytes held by every structure, heap buffers and container overheads included
+  MemoryUsageInfo GetMemoryUsage(size_t request_id) const;
 private:
   std::unordered_map<std::string, size_t> stop_idx;
   std::vector<Stop> stops_;
-  std::unordered_map<size_t, std::unordered_map<size_t, unsigned int>> distances_;
+  RoadDistances distances_;
   std::unordered_map<RouteNumber, BusRoute> buses_;
   RoutingSettings routing_settings_;
-  std::unique_ptr<Graph::DirectedWeightedGraph<double>> road_graph{nullptr};
-  std::unique_ptr<Graph::Router<double>> router{nullptr};
-  std::vector<std::variant<WaitActivity, BusActivity>> edge_description;
+  std::unique_ptr<RoadGraph> road_graph{nullptr};
+  std::unique_ptr<Graph::Router<RouteWeight, GraphId>> router{nullptr};
+  std::unique_ptr<Graph::ParetoRouter<RouteWeight, GraphId>> pareto_router{nullptr};
+  std::vector<const BusRoute*> routes_;
+  std::vector<EdgeDescription> edge_description;
+  std::vector<double> edge_times_;  // time of every graph edge in double
+  SpatialIndex stop_index_;
+  Timetable timetable_;
+  std::vector<uint32_t> trip_routes_;  // route index of every timetable trip
+
+  StopId InitStop(const std::string& name);
+  void FreezeDistances();
+  void CreateTimetable();
+  double ComputeTravelTime(StopId from, StopId to) const;
+  double ComputeEdgeTime(GraphId edge_id) const;
+
+  // Times of the routes the router picked from one vertex, summed in double
+  // edge by edge the way Route does. The routes share their prefixes, so
+  // every vertex is summed once until the next Reset
+  struct RouteTimes {
+    explicit RouteTimes(size_t vertex_count);
+    void Reset(GraphId from);
 
-  void InitStop(const std::string& name);
+    GraphId from_vertex{0};
+    std::vector<std::optional<double>> times;
+    std::vector<GraphId> summed;
+    std::vector<GraphId> pending_edges;
+  };
+  std::optional<double> ComputeRouteTime(RouteTimes& route_times, GraphId to_vertex) const;
+  std::variant<WaitActivity, BusActivity> DescribeEdge(GraphId edge_id) const;
+  RouteInfo BuildRouteInfo(GraphId from_vertex, GraphId to_vertex, size_t request_id);
+  double DescribeEdges(const std::vector<GraphId>& edges, std::vector<std::variant<WaitActivity, BusActivity>>& items) const;
 };
 
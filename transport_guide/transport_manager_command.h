@@ -1,5 +1,7 @@
 #pragma once
 
+#include "bus.h"
+
 #include <algorithm>
 #include <limits>
 #include <string>
@@ -21,6 +23,14 @@ enum class OutCommandType {
   STOP_DESCRIPTION,
   BUS_DESCRIPTION,
   ROUTE,
+  PARETO_ROUTE,
+  ROUTE_MATRIX,
+  ISOCHRONE,
+  NEAREST_STOPS,
+  STOPS_IN_BOX,
+  ROUTE_FROM_POINT,
+  TIMED_ROUTE,
+  MEMORY_USAGE,
 
   NUM_COMMANDS,
 };
@@ -28,6 +38,7 @@ enum class OutCommandType {
 struct InCommand {
 public:
   InCommand(InCommandType type) : type_(type) {}
+  virtual ~InCommand() = default;
   virtual InCommandType Type() const { return type_; }
 
 private:
@@ -37,6 +48,7 @@ private:
 struct OutCommand {
 public:
   OutCommand(OutCommandType type) : type_(type) {}
+  virtual ~OutCommand() = default;
   virtual OutCommandType Type() const { return type_; }
 
 private:
@@ -65,7 +77,7 @@ public:
   {
   }
 
-  std::string Name() const { return name_; }
+  const std::string& Name() const { return name_; }
   double Latitude() const { return latitude_; }
   double Longitude() const { return longitude_; }
   const auto& Distances() const { return distances_; }
@@ -79,22 +91,25 @@ private:
 
 struct NewBusCommand : public InCommand {
 public: 
-  NewBusCommand(std::string name, std::vector<std::string> stops, bool is_cyclic)
+  NewBusCommand(std::string name, std::vector<std::string> stops, bool is_cyclic, std::vector<BusInterval> intervals = {})
     : InCommand(InCommandType::NEW_BUS)
     , name_(move(name))
     , stops_(move(stops))
     , cyclic_(is_cyclic)
+    , intervals_(move(intervals))
   {
   }
 
-  std::string Name() const { return name_; }
-  std::vector<std::string> Stops() const { return stops_; }
+  const std::string& Name() const { return name_; }
+  const std::vector<std::string>& Stops() const { return stops_; }
   bool IsCyclic() const { return cyclic_; }
+  const std::vector<BusInterval>& Intervals() const { return intervals_; }
 
 private:
   std::string name_;
   std::vector<std::string> stops_;
   bool cyclic_;
+  std::vector<BusInterval> intervals_;
 };
 
 struct StopDescriptionCommand : public OutCommand {
@@ -170,6 +185,185 @@ private:
   size_t request_id_{std::numeric_limits<size_t>::max()};
 };
 
+struct ParetoRouteCommand : public OutCommand {
+public:
+  static constexpr size_t DEFAULT_MAX_ROUTES = 4;
+
+  ParetoRouteCommand(std::string from, std::string to, size_t max_routes, size_t request_id)
+    : OutCommand(OutCommandType::PARETO_ROUTE)
+    , from_(move(from))
+    , to_(move(to))
+    , max_routes_(max_routes)
+    , request_id_(request_id)
+  {
+  }
+
+  std::string From() const { return from_; }
+  std::string To() const { return to_; }
+  size_t MaxRoutes() const { return max_routes_; }
+  size_t RequestId() const { return request_id_; }
+
+private:
+  std::string from_;
+  std::string to_;
+  size_t max_routes_{DEFAULT_MAX_ROUTES};
+  size_t request_id_{std::numeric_limits<size_t>::max()};
+};
+
+struct RouteMatrixCommand : public OutCommand {
+public:
+  RouteMatrixCommand(std::vector<std::string> from, std::vector<std::string> to, size_t request_id)
+    : OutCommand(OutCommandType::ROUTE_MATRIX)
+    , from_(move(from))
+    , to_(move(to))
+    , request_id_(request_id)
+  {
+  }
+
+  const std::vector<std::string>& From() const { return from_; }
+  const std::vector<std::string>& To() const { return to_; }
+  size_t RequestId() const { return request_id_; }
+
+private:
+  std::vector<std::string> from_;
+  std::vector<std::string> to_;
+  size_t request_id_{std::numeric_limits<size_t>::max()};
+};
+
+struct IsochroneCommand : public OutCommand {
+public:
+  IsochroneCommand(std::string from, double max_time, size_t request_id)
+    : OutCommand(OutCommandType::ISOCHRONE)
+    , from_(move(from))
+    , max_time_(max_time)
+    , request_id_(request_id)
+  {
+  }
+
+  std::string From() const { return from_; }
+  double MaxTime() const { return max_time_; }
+  size_t RequestId() const { return request_id_; }
+
+private:
+  std::string from_;
+  double max_time_;
+  size_t request_id_{std::numeric_limits<size_t>::max()};
+};
+
+struct NearestStopsCommand : public OutCommand {
+public:
+  NearestStopsCommand(double latitude, double longitude, size_t count, size_t request_id)
+    : OutCommand(OutCommandType::NEAREST_STOPS)
+    , latitude_(latitude)
+    , longitude_(longitude)
+    , count_(count)
+    , request_id_(request_id)
+  {
+  }
+
+  double Latitude() const { return latitude_; }
+  double Longitude() const { return longitude_; }
+  size_t Count() const { return count_; }
+  size_t RequestId() const { return request_id_; }
+
+private:
+  double latitude_;
+  double longitude_;
+  size_t count_;
+  size_t request_id_{std::numeric_limits<size_t>::max()};
+};
+
+struct StopsInBoxCommand : public OutCommand {
+public:
+  StopsInBoxCommand(double min_latitude, double min_longitude, double max_latitude, double max_longitude, size_t request_id)
+    : OutCommand(OutCommandType::STOPS_IN_BOX)
+    , min_latitude_(min_latitude)
+    , min_longitude_(min_longitude)
+    , max_latitude_(max_latitude)
+    , max_longitude_(max_longitude)
+    , request_id_(request_id)
+  {
+  }
+
+  double MinLatitude() const { return min_latitude_; }
+  double MinLongitude() const { return min_longitude_; }
+  double MaxLatitude() const { return max_latitude_; }
+  double MaxLongitude() const { return max_longitude_; }
+  size_t RequestId() const { return request_id_; }
+
+private:
+  double min_latitude_;
+  double min_longitude_;
+  double max_latitude_;
+  double max_longitude_;
+  size_t request_id_{std::numeric_limits<size_t>::max()};
+};
+
+struct RouteFromPointCommand : public OutCommand {
+public:
+  static constexpr size_t DEFAULT_SNAP_COUNT = 3;
+
+  RouteFromPointCommand(double latitude, double longitude, std::string to, size_t snap_count, size_t request_id)
+    : OutCommand(OutCommandType::ROUTE_FROM_POINT)
+    , latitude_(latitude)
+    , longitude_(longitude)
+    , to_(move(to))
+    , snap_count_(snap_count)
+    , request_id_(request_id)
+  {
+  }
+
+  double Latitude() const { return latitude_; }
+  double Longitude() const { return longitude_; }
+  std::string To() const { return to_; }
+  size_t SnapCount() const { return snap_count_; }
+  size_t RequestId() const { return request_id_; }
+
+private:
+  double latitude_;
+  double longitude_;
+  std::string to_;
+  size_t snap_count_{DEFAULT_SNAP_COUNT};
+  size_t request_id_{std::numeric_limits<size_t>::max()};
+};
+
+struct TimedRouteCommand : public OutCommand {
+public:
+  TimedRouteCommand(std::string from, std::string to, double departure_time, size_t request_id)
+    : OutCommand(OutCommandType::TIMED_ROUTE)
+    , from_(move(from))
+    , to_(move(to))
+    , departure_time_(departure_time)
+    , request_id_(request_id)
+  {
+  }
+
+  std::string From() const { return from_; }
+  std::string To() const { return to_; }
+  double DepartureTime() const { return departure_time_; }
+  size_t RequestId() const { return request_id_; }
+
+private:
+  std::string from_;
+  std::string to_;
+  double departure_time_;
+  size_t request_id_{std::numeric_limits<size_t>::max()};
+};
+
+struct MemoryUsageCommand : public OutCommand {
+public:
+  MemoryUsageCommand(size_t request_id)
+    : OutCommand(OutCommandType::MEMORY_USAGE)
+    , request_id_(request_id)
+  {
+  }
+
+  size_t RequestId() const { return request_id_; }
+
+private:
+  size_t request_id_{std::numeric_limits<size_t>::max()};
+};
+
 struct StopInfo {
   std::vector<std::string> buses;
   size_t request_id;
@@ -187,8 +381,7 @@ struct BusInfo {
 
 struct WaitActivity {
   std::string type;
-  //double time;
-  unsigned int time;
+  double time;
   std::string stop_name;
 };
 
@@ -205,3 +398,63 @@ struct RouteInfo {
   std::vector<std::variant<WaitActivity, BusActivity>> items;
   std::optional<std::string> error_message;
 };
+
+struct RouteOption {
+  double total_time;
+  size_t transfer_count;
+  std::vector<std::variant<WaitActivity, BusActivity>> items;
+};
+
+struct ParetoRouteInfo {
+  size_t request_id;
+  std::vector<RouteOption> routes;
+  std::optional<std::string> error_message;
+};
+
+struct RouteMatrixInfo {
+  size_t request_id;
+  size_t column_count;
+  // row-major from.size() x to.size() table, nullopt for unreachable pairs
+  std::vector<std::optional<double>> total_times;
+  std::optional<std::string> error_message;
+};
+
+struct ReachableStop {
+  std::string stop_name;
+  double total_time;
+};
+
+struct IsochroneInfo {
+  size_t request_id;
+  std::vector<ReachableStop> stops;
+  std::optional<std::string> error_message;
+};
+
+struct NearbyStop {
+  std::string stop_name;
+  double distance;
+};
+
+struct NearestStopsInfo {
+  size_t request_id;
+  std::vector<NearbyStop> stops;
+  std::optional<std::string> error_message;
+};
+
+struct StopsInBoxInfo {
+  size_t request_id;
+  std::vector<std::string> stops;
+  std::optional<std::string> error_message;
+};
+
+struct MemoryComponent {
+  std::string name;
+  size_t bytes;
+};
+
+struct MemoryUsageInfo {
+  size_t request_id;
+  std::vector<MemoryComponent> components;
+  size_t total_bytes;
+  std::optional<std::string> error_message;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string_view>
+
+// Both conversions count years from March, so that the leap day closes a
+// year, and split time into 400-year eras of 146097 days, see
+// http://howardhinnant.github.io/date_algorithms.html
+
+// Number of days since 1970-01-01 in the proleptic Gregorian calendar.
+// Days past the end of a month roll over into the next one, as with mktime.
+constexpr int DaysFromCivil(int year, int month, int day) {
+  year -= month <= 2;
+  const int era = (year >= 0 ? year : year - 399) / 400;
+  const int year_of_era = year - era * 400;
+  const int day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  const int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+struct CivilDate {
+  int year;
+  int month;
+  int day;
+};
+
+constexpr CivilDate CivilFromDays(int day_number) {
+  day_number += 719468;
+  const int era = (day_number >= 0 ? day_number : day_number - 146096) / 146097;
+  const int day_of_era = day_number - era * 146097;
+  const int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  const int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const int shifted_month = (5 * day_of_year + 2) / 153;
+  const int day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+  const int month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+  return {year_of_era + era * 400 + (month <= 2), month, day};
+}
+
+static_assert(DaysFromCivil(1970, 1, 1) == 0);
+static_assert(DaysFromCivil(2100, 1, 1) - DaysFromCivil(2000, 1, 1) == 36525);
+static_assert(CivilFromDays(DaysFromCivil(2000, 2, 29)).day == 29);
+static_assert(CivilFromDays(DaysFromCivil(2099, 12, 31) + 1).year == 2100);
+
+// Value of a fixed-width field of digits, -1 if there is anything else
+constexpr int ParseDigits(std::string_view str) {
+  int result = 0;
+  for (const char c : str) {
+    if (c < '0' || c > '9') {
+      return -1;
+    }
+    result = result * 10 + (c - '0');
+  }
+  return result;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Segment tree over [0, size) with range operations postponed in inner nodes.
+// Both parameters are stateless types, so all calls are resolved at compile
+// time:
+//
+//   struct Monoid {
+//     using Value = ...;
+//     static Value Identity();
+//     static Value Combine(const Value& lhs, const Value& rhs);
+//   };
+//
+//   struct Action {
+//     using Operation = ...;
+//     static Operation Identity();
+//     // earlier, then later
+//     static Operation Compose(const Operation& earlier, const Operation& later);
+//     // length is the number of positions combined into value
+//     static Value Apply(const Operation& operation, const Value& value, size_t length);
+//   };
+//
+// The tree is a perfect binary tree in two arrays, values and postponed
+// operations of inner nodes, and both queries and updates walk it bottom-up
+// without recursion.
+template <typename Monoid, typename Action>
+class LazySegmentTree {
+public:
+  using Value = typename Monoid::Value;
+  using Operation = typename Action::Operation;
+
+  explicit LazySegmentTree(size_t size)
+      : LazySegmentTree(std::vector<Value>(size, Monoid::Identity()))
+  {}
+
+  explicit LazySegmentTree(const std::vector<Value>& values)
+      : size_(values.size())
+      , height_(ComputeHeight(values.size()))
+      , leaf_count_(size_t{1} << height_)
+      , values_(2 * leaf_count_, Monoid::Identity())
+      , operations_(leaf_count_, Action::Identity())
+  {
+    std::copy(values.begin(), values.end(), values_.begin() + leaf_count_);
+    for (size_t node = leaf_count_ - 1; node > 0; --node) {
+      Update(node);
+    }
+  }
+
+  size_t Size() const {
+    return size_;
+  }
+
+  // Combination of the values in [left, right)
+  Value Fold(size_t left, size_t right) const {
+    if (left >= right) {
+      return Monoid::Identity();
+    }
+    left += leaf_count_;
+    right += leaf_count_;
+    PushAncestors(left, right);
+
+    Value left_sum = Monoid::Identity();
+    Value right_sum = Monoid::Identity();
+    for (; left < right; left /= 2, right /= 2) {
+      if (left % 2 == 1) {
+        left_sum = Monoid::Combine(left_sum, values_[left++]);
+      }
+      if (right % 2 == 1) {
+        right_sum = Monoid::Combine(values_[--right], right_sum);
+      }
+    }
+    return Monoid::Combine(left_sum, right_sum);
+  }
+
+  void Apply(size_t left, size_t right, const Operation& operation) {
+    if (left >= right) {
+      return;
+    }
+    left += leaf_count_;
+    right += leaf_count_;
+    PushAncestors(left, right);
+
+    size_t length = 1;
+    for (size_t l = left, r = right; l < r; l /= 2, r /= 2, length *= 2) {
+      if (l % 2 == 1) {
+        ApplyToNode(l++, operation, length);
+      }
+      if (r % 2 == 1) {
+        ApplyToNode(--r, operation, length);
+      }
+    }
+
+    for (size_t level = 1; level <= height_; ++level) {
+      if (((left >> level) << level) != left) {
+        Update(left >> level);
+      }
+      if (((right >> level) << level) != right) {
+        Update((right - 1) >> level);
+      }
+    }
+  }
+
+private:
+  size_t size_;
+  size_t height_;
+  size_t leaf_count_;
+  // Queries push postponed operations down as well
+  mutable std::vector<Value> values_;
+  mutable std::vector<Operation> operations_;
+
+  static size_t ComputeHeight(size_t size) {
+    size_t height = 0;
+    while ((size_t{1} << height) < size) {
+      ++height;
+    }
+    return height;
+  }
+
+  void Update(size_t node) const {
+    values_[node] = Monoid::Combine(values_[2 * node], values_[2 * node + 1]);
+  }
+
+  void ApplyToNode(size_t node, const Operation& operation, size_t length) const {
+    values_[node] = Action::Apply(operation, values_[node], length);
+    if (node < leaf_count_) {
+      operations_[node] = Action::Compose(operations_[node], operation);
+    }
+  }
+
+  // node is at the given level above the leaves
+  void Push(size_t node, size_t level) const {
+    const size_t child_length = size_t{1} << (level - 1);
+    ApplyToNode(2 * node, operations_[node], child_length);
+    ApplyToNode(2 * node + 1, operations_[node], child_length);
+    operations_[node] = Action::Identity();
+  }
+
+  // Pushes the operations above the bounds of the leaf range [left, right),
+  // top-down, so nodes inside the range see all older operations
+  void PushAncestors(size_t left, size_t right) const {
+    for (size_t level = height_; level >= 1; --level) {
+      if (((left >> level) << level) != left) {
+        Push(left >> level, level);
+      }
+      if (((right >> level) << level) != right) {
+        Push((right - 1) >> level, level);
+      }
+    }
+  }
+};